@@ -76,6 +76,31 @@ void recv(T& Data, size_t SenderID, MPI_Comm Comm, size_t MsgTag = GENERIC_TAG)
     Data = deserialize<T>(BinData);
 }
 
+///Starts sending already serialized data, \p BinData must be left alone
+///until \p Request completes
+inline void isend(const binary_type& BinData, MPI_Request& Request,
+                  size_t RecvID, MPI_Comm Comm, size_t MsgTag = GENERIC_TAG)
+{
+    int Error = MPI_Isend(BinData.data(), (int) BinData.size(), MPI_BYTE,
+                          (int) RecvID, (int) MsgTag, Comm, &Request);
+    PARALLEL_ASSERT(Error == MPI_SUCCESS, "Isend failed");
+}
+
+///Receives a message sent by isend(), the length comes from the message
+template<typename T>
+void recv_sized(T& Data, size_t SenderID, MPI_Comm Comm,
+                size_t MsgTag = GENERIC_TAG)
+{
+    const int Sender = (int) SenderID;
+    MPI_Status Status;
+    MPI_Probe(Sender, (int) MsgTag, Comm, &Status);
+    int Length;
+    MPI_Get_count(&Status, MPI_BYTE, &Length);
+    binary_type BinData(Length);
+    MPI_Recv(BinData.data(), Length, MPI_BYTE, Sender, (int) MsgTag, Comm, MPI_STATUS_IGNORE);
+    Data = deserialize<T>(BinData);
+}
+
 template<typename T>
 void bcast(T& Data, MPI_Comm Comm, size_t RootID = ROOT_PROCESS)
 {
@@ -112,6 +137,30 @@ T all_gatherv(T& Data,MPI_Comm Comm)
 }
 
 
+///Gathers one T from every process, returned in rank order
+template<typename T>
+std::vector<T> all_gather(const T& Data,MPI_Comm Comm)
+{
+    binary_type BinData = serialize(Data);
+    int Length = (int) BinData.size();
+    const size_t NProcs = size(Comm);
+    std::vector<int> Lengths(NProcs),Displacements(NProcs);
+    int Error = MPI_Allgather(&Length, 1, MPI_INT, Lengths.data(), 1, MPI_INT, Comm);
+    PARALLEL_ASSERT(Error == MPI_SUCCESS, "Allgather failed");
+    for (size_t i = 1; i < NProcs; ++i)
+        Displacements[i] = Displacements[i - 1] + Lengths[i - 1];
+    binary_type Buffer(Displacements.back() + Lengths.back());
+    Error = MPI_Allgatherv(BinData.data(), Length, MPI_BYTE, Buffer.data(),
+            Lengths.data(), Displacements.data(), MPI_BYTE, Comm);
+    PARALLEL_ASSERT(Error == MPI_SUCCESS, "Allgatherv failed");
+    std::vector<T> Result;
+    for (size_t i = 0; i < NProcs; ++i) {
+        binary_type Piece(Buffer.begin() + Displacements[i],
+                          Buffer.begin() + Displacements[i] + Lengths[i]);
+        Result.push_back(deserialize<T>(Piece));
+    }
+    return Result;
+}
 
 }//End namespace LibTaskForce
 #endif /* LIBTASKFORCE_GHUARD_MPIWRAPPERS_HPP */
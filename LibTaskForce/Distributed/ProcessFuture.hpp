@@ -29,7 +29,10 @@
 #ifndef LIBTASKFORCE_GUARD_PROCESSFUTURE_HPP
 #define LIBTASKFORCE_GUARD_PROCESSFUTURE_HPP
 
+#include<chrono>
 #include<memory>
+#include<type_traits>
+#include<vector>
 #include "LibTaskForce/Distributed/MPIWrappers.hpp"
 #include "LibTaskForce/Distributed/Scheduler.hpp"
 namespace LibTaskForce {
@@ -37,14 +40,33 @@ namespace LibTaskForce {
 template<typename T>
 class ProcessFuture {
 private:
-    std::unique_ptr<T> Data_;///<The actual data
-    size_t Rank_;///<The rank that actually owns this data
-    Scheduler* Scheduler_;///<The comm for data transfer
+    std::unique_ptr<T> Data_;///<The actual data, if we have it
+    size_t Rank_=0;///<The rank that actually owns this data
+    Scheduler* Scheduler_=nullptr;///<The comm for data transfer, NULL once
+                                  ///<the value has been taken
+    bool Shared_=false;///<True once every process has the data
+    
+    ///True if this process owns the data
+    bool mine()const{return Rank_==Scheduler_->me();}
+    
+    ///Broadcasts the data from its owner the first time it's called
+    void fetch(){
+        PARALLEL_ASSERT(valid(),"This future's value was already taken");
+        if(Shared_)return;
+        if(!Data_)Data_.reset(new T);
+        bcast(*Data_,Scheduler_->mpi_comm(),Rank_);
+        Shared_=true;
+    }
 public:
     ///Constructor for making a future when this process is responsible for data
     ProcessFuture(const T& Data,size_t Me,Scheduler* Sc):
             Data_(new T(Data)),Rank_(Me),Scheduler_(Sc)
     {}
+    
+    ///Same as above, but takes the data over instead of copying it
+    ProcessFuture(T&& Data,size_t Me,Scheduler* Sc):
+            Data_(new T(std::move(Data))),Rank_(Me),Scheduler_(Sc)
+    {}
         
     ///Constructor for making a future when this process is not responsible
     ProcessFuture(size_t Owner,Scheduler* Sc) :
@@ -59,16 +81,106 @@ public:
     
     
     bool empty()const{return !Data_;}///<Returns true if this future is empty
+    size_t owner()const{return Rank_;}///<The rank that has the value
+    
+    /** \brief Readiness queries, same interface as ThreadFuture
+     * 
+     *  The owning process runs the task before add_task() returns, so the
+     *  value always exists somewhere by the time anyone can ask.  It still
+     *  takes get() (a collective) to bring it to this process.
+     */
+    ///@{
+    bool valid()const{return Scheduler_!=nullptr;}
+    bool is_ready()const{return true;}
+    template<typename Rep,typename Period>
+    bool wait_for(const std::chrono::duration<Rep,Period>&)const{return true;}
+    ///@}
     
-    ///Returns the value of the future (requires communication)
+    /** \brief Returns the value of the future (requires communication)
+     * 
+     *  The value is moved out of the future, so this may only be called
+     *  once.  Use value() to read it repeatedly.
+     */
     T get(){
-        T NewData;
-        bcast((empty()?NewData:*Data_),Scheduler_->mpi_comm(),Rank_);
-        return (empty()? NewData : *Data_);
+        fetch();
+        std::unique_ptr<T> Data(std::move(Data_));
+        Scheduler_=nullptr;
+        return std::move(*Data);
+    }
+    
+    /** \brief Returns a reference to the value, for repeated reads
+     * 
+     *  The first call is a collective like get(), later calls are free.
+     *  The reference is good until the value is taken or the future is
+     *  destroyed.
+     */
+    const T& value(){
+        fetch();
+        return *Data_;
+    }
+    
+    /** \brief Applies \p Fxn to this future's value without communicating
+     * 
+     *  \p Fxn is only called on the rank that owns the value; every other
+     *  rank gets an empty future to the same owner.  Hence the
+     *  communication is deferred until (and only happens if) get() is
+     *  called on the result.  Consumes this future.
+     * 
+     *  \param[in] Fxn A functor taking a T
+     *  \return A future to the result of \p Fxn
+     */
+    template<typename FxnType>
+    ProcessFuture<typename std::result_of<FxnType(T)>::type>
+    then(FxnType&& Fxn){
+        using return_type=typename std::result_of<FxnType(T)>::type;
+        PARALLEL_ASSERT(valid(),"This future's value was already taken");
+        Scheduler* Sc=Scheduler_;
+        Scheduler_=nullptr;
+        if(Rank_!=Sc->me())return ProcessFuture<return_type>(Rank_,Sc);
+        std::unique_ptr<T> Data(std::move(Data_));
+        return ProcessFuture<return_type>(Fxn(std::move(*Data)),Rank_,Sc);
     }
     
+    
+    /** \brief Gets the values of several process futures with one collective
+     * 
+     *  Calling get() on each future is one broadcast per future.  Here every
+     *  process sends the values it owns in a single all-gather instead.  All
+     *  of \p Futures must come from the same comm, and, like get(), this must
+     *  be called by every process on it.  The futures are consumed.
+     */
+    static std::vector<T> gather(const std::vector<ProcessFuture<T>*>& Futures)
+    {
+        std::vector<T> Values;
+        if(Futures.empty())return Values;
+        const Scheduler* Sc=Futures[0]->Scheduler_;
+        std::vector<T> Mine;
+        for(ProcessFuture<T>* Future:Futures){
+            PARALLEL_ASSERT(Future->valid(),"A future's value was already taken");
+            if(Future->mine())Mine.push_back(std::move(*Future->Data_));
+            Future->Data_.reset();
+            Future->Scheduler_=nullptr;
+        }
+        std::vector<std::vector<T>> Theirs=all_gather(Mine,Sc->mpi_comm());
+        std::vector<size_t> NTaken(Theirs.size(),0);
+        Values.reserve(Futures.size());
+        for(const ProcessFuture<T>* Future:Futures){
+            const size_t Owner=Future->owner();
+            Values.push_back(std::move(Theirs[Owner][NTaken[Owner]++]));
+        }
+        return Values;
+    }
 };
 
+///Overload of when_all() for a vector of process futures
+template<typename T>
+std::vector<T> when_all(std::vector<ProcessFuture<T>>& Futures)
+{
+    std::vector<ProcessFuture<T>*> Ptrs;
+    for(ProcessFuture<T>& Future:Futures)Ptrs.push_back(&Future);
+    return ProcessFuture<T>::gather(Ptrs);
+}
+
 }//End namespace LIbTaskForce
 #endif /* LIBTASKFORCE_GUARD_PROCESSFUTURE_HPP */
 
@@ -0,0 +1,233 @@
+/*  
+ *   LibTaskForce: An open-source library for task-based parallelism
+ * 
+ *   Copyright (C) 2016 Ryan M. Richard
+ * 
+ *   This file is part of LibTaskForce.
+ *
+ *   LibTaskForce is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LibTaskForce is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LibTaskForce.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+/** \file ProcessGraph.hpp
+ *  \brief Recorded graphs of tasks for ProcessComm
+ *  \author Ryan M. Richard
+ *  \version 1.0
+ *  \date October 17, 2026
+ */
+
+#ifndef LIBTASKFORCE_GUARD_PROCESSGRAPH_HPP
+#define LIBTASKFORCE_GUARD_PROCESSGRAPH_HPP
+
+#include <mpi.h>
+#include <algorithm>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <type_traits>
+#include <vector>
+#include "LibTaskForce/Distributed/MPIWrappers.hpp"
+#include "LibTaskForce/Distributed/ProcessComm.hpp"
+#include "LibTaskForce/General/GraphNode.hpp"
+#include "LibTaskForce/Util/ParallelAssert.hpp"
+
+namespace LibTaskForce {
+
+/** \brief The ProcessComm counterpart of TaskGraph
+ * 
+ *  Every process records the same nodes and edges (the usual SPMD style).
+ *  Node i is owned by process i%size(), just like the i-th task given to
+ *  ProcessComm::add_task.  Recording works out, once, which values each
+ *  process has to send and to whom, so a replay only runs the owned nodes
+ *  in order.  Predecessor values from other processes are received right
+ *  before they are needed, and values are sent, without waiting, as soon as
+ *  they are computed.  Edges must point from earlier nodes to later ones,
+ *  which is what add_node() gives you anyway; because of that, and because
+ *  sends don't block, a run cannot deadlock.
+ * 
+ *  \code
+ *  ProcessGraph Graph(Comm);
+ *  GraphNode<double> A=Graph.add_node<double>(MakeA());
+ *  GraphNode<double> B=Graph.add_node<double>([&](ProcessComm&){
+ *      return 2.0*Graph.value(A);
+ *  },{A});
+ *  for(size_t Iter=0;Iter<NIters;++Iter){
+ *      Graph.run();
+ *      double X=Graph.bcast(B);
+ *  }
+ *  \endcode
+ * 
+ *  Values are serialized like ProcessFuture values.  As with
+ *  ProcessComm::add_task, an exception thrown by a node comes out of run()
+ *  on the node's owner.
+ */
+class ProcessGraph{
+private:
+    ///What every node has, regardless of its type
+    struct NodeBase{
+        size_t Owner_;///< The process that runs the node
+        std::vector<size_t> Preds_;///< The nodes it depends on
+        std::vector<size_t> Readers_;///< Other processes that need its value
+        bool Have_;///< True if we have the value from the current run
+        binary_type Buffer_;///< The serialized value while it is being sent
+        NodeBase(size_t Owner):Owner_(Owner),Have_(false){}
+        virtual ~NodeBase()=default;
+        virtual void compute(ProcessComm& Comm)=0;///< Runs the functor
+        virtual void pack()=0;///< Serializes the value into Buffer_
+        ///Receives the value from its owner
+        virtual void receive(MPI_Comm Comm,size_t Tag)=0;
+    };
+    
+    ///A node whose functor returns a \p T
+    template<typename T>
+    struct TypedNode:public NodeBase{
+        using fxn_type=std::function<T(ProcessComm&)>;
+        fxn_type Fxn_;///< What the node does
+        T Value_;///< The node's result (if we have it, see Have_)
+        TypedNode(fxn_type&& Fxn,size_t Owner):
+            NodeBase(Owner),Fxn_(std::move(Fxn)),Value_()
+        {}
+        void compute(ProcessComm& Comm){Value_=Fxn_(Comm);}
+        void pack(){Buffer_=serialize(Value_);}
+        void receive(MPI_Comm Comm,size_t Tag)
+        {
+            recv_sized(Value_,Owner_,Comm,Tag);
+        }
+    };
+    
+    ProcessComm* Comm_;///< Given to the nodes
+    MPI_Comm MPIComm_;///< Our own copy, so our messages can't mix with others
+    size_t Me_;///< Our rank
+    size_t TagUB_;///< Largest tag MPI allows, hence most nodes we can have
+    std::vector<std::unique_ptr<NodeBase>> Nodes_;///< The nodes, in order
+    std::vector<MPI_Request> Requests_;///< The sends of the current run
+    
+    ///The value of \p Index, which must be a node returning a \p T
+    template<typename T>
+    T& value_of(size_t Index)const
+    {
+        return static_cast<TypedNode<T>*>(Nodes_[Index].get())->Value_;
+    }
+public:
+    ///Makes an empty graph over \p Comm, collective
+    explicit ProcessGraph(ProcessComm& Comm):
+        Comm_(&Comm),Me_(Comm.rank())
+    {
+        MPI_Comm_dup(Comm.mpi_comm(),&MPIComm_);
+        int* TagUB;
+        int Found;
+        MPI_Comm_get_attr(MPIComm_,MPI_TAG_UB,&TagUB,&Found);
+        TagUB_=Found?static_cast<size_t>(*TagUB):32767;
+    }
+    
+    ///Frees our copy of the MPI communicator, collective
+    ~ProcessGraph(){MPI_Comm_free(&MPIComm_);}
+    
+    ///Graphs are referred to by their nodes, so they can't be copied or moved
+    ///@{
+    ProcessGraph(const ProcessGraph&)=delete;
+    ProcessGraph& operator=(const ProcessGraph&)=delete;
+    ///@}
+    
+    size_t size()const{return Nodes_.size();}///< The number of nodes
+    
+    /** \brief Adds a node that runs \p Fxn after the nodes in \p After
+     * 
+     *  \param[in] Fxn A copyable functor with the signature of those given
+     *                 to ProcessComm::add_task; \p return_type must be
+     *                 serializable and default constructable
+     *  \param[in] After Nodes that must finish before this one starts
+     *  \return A handle to the new node
+     */
+    template<typename return_type,typename functor_type>
+    GraphNode<return_type> add_node(functor_type&& Fxn,
+                                    std::initializer_list<GraphNodeBase> After={})
+    {
+        PARALLEL_ASSERT(size()<=TagUB_,"Too many nodes for MPI's tags");
+        using fxn_type=typename TypedNode<return_type>::fxn_type;
+        GraphNode<return_type> NewNode;
+        NewNode.Index_=size();
+        Nodes_.emplace_back(new TypedNode<return_type>(
+            fxn_type(std::forward<functor_type>(Fxn)),
+            NewNode.Index_%Comm_->size()));
+        for(const GraphNodeBase& Pred:After)add_edge(Pred,NewNode);
+        return NewNode;
+    }
+    
+    ///Makes \p To wait for \p From, which must be an earlier node
+    void add_edge(const GraphNodeBase& From,const GraphNodeBase& To)
+    {
+        PARALLEL_ASSERT(From.Index_<To.Index_ && To.Index_<size(),
+                        "Edges must go from an earlier node to a later one");
+        NodeBase& Pred=*Nodes_[From.Index_];
+        NodeBase& Succ=*Nodes_[To.Index_];
+        Succ.Preds_.push_back(From.Index_);
+        if(Succ.Owner_!=Pred.Owner_ &&
+           std::find(Pred.Readers_.begin(),Pred.Readers_.end(),Succ.Owner_)==
+                Pred.Readers_.end())
+            Pred.Readers_.push_back(Succ.Owner_);
+    }
+    
+    ///Runs the nodes this process owns, returns once their values are sent
+    void run()
+    {
+        for(std::unique_ptr<NodeBase>& Ni:Nodes_)Ni->Have_=false;
+        Requests_.clear();
+        for(size_t i=0;i<size();++i){
+            NodeBase& Ni=*Nodes_[i];
+            if(Ni.Owner_!=Me_)continue;
+            for(size_t Pred:Ni.Preds_){
+                NodeBase& Pj=*Nodes_[Pred];
+                if(Pj.Have_)continue;
+                Pj.receive(MPIComm_,Pred);
+                Pj.Have_=true;
+            }
+            Ni.compute(*Comm_);
+            Ni.Have_=true;
+            if(Ni.Readers_.empty())continue;
+            Ni.pack();
+            for(size_t Reader:Ni.Readers_){
+                Requests_.emplace_back();
+                isend(Ni.Buffer_,Requests_.back(),Reader,MPIComm_,i);
+            }
+        }
+        MPI_Waitall((int)Requests_.size(),Requests_.data(),MPI_STATUSES_IGNORE);
+    }
+    
+    ///True if this process has \p Node's value from the last run
+    bool have(const GraphNodeBase& Node)const
+    {
+        return Nodes_[Node.Index_]->Have_;
+    }
+    
+    ///The value of \p Node from the last run, only on processes that have()
+    ///it (its owner and those that ran a node that depends on it)
+    template<typename T>
+    const T& value(const GraphNode<T>& Node)const
+    {
+        PARALLEL_ASSERT(have(Node),"This process doesn't have that value");
+        return value_of<T>(Node.Index_);
+    }
+    
+    ///The value of \p Node from the last run on every process, collective
+    template<typename T>
+    T bcast(const GraphNode<T>& Node)const
+    {
+        T Value=Nodes_[Node.Index_]->Owner_==Me_?value_of<T>(Node.Index_):T();
+        LibTaskForce::bcast(Value,MPIComm_,Nodes_[Node.Index_]->Owner_);
+        return Value;
+    }
+};
+
+}//End namespace LibTaskForce
+#endif /* LIBTASKFORCE_GUARD_PROCESSGRAPH_HPP */
@@ -47,11 +47,10 @@ public:
     ProcessFuture<return_type> add_task(const task_type& Task)
     {
         using FutureType=ProcessFuture<return_type>;
-        FutureType Temp;
-        if(Scheduler_.my_task(NTasks_))
-            Temp=FutureType(Task(),Scheduler_.me(),&Scheduler_);
-        else 
-            Temp=FutureType(Scheduler_.who_runs_task(NTasks_),&Scheduler_);
+        //The result is moved (not copied) into the future
+        FutureType Temp=Scheduler_.my_task(NTasks_)?
+            FutureType(Task(),Scheduler_.me(),&Scheduler_):
+            FutureType(Scheduler_.who_runs_task(NTasks_),&Scheduler_);
         ++NTasks_;
         return Temp;
     }
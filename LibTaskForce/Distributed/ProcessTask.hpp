@@ -39,7 +39,7 @@ struct ProcessTask: public Task<T,functor_type,comm_type>{
     using Task<T,functor_type,comm_type>::Task;
     
     T operator()()const{
-        return this->Fxn_->operator()(this->CurrentComm_);
+        return this->Fxn_(this->CurrentComm_);
     }
     
 };
@@ -0,0 +1,186 @@
+/*  
+ *   LibTaskForce: An open-source library for task-based parallelism
+ * 
+ *   Copyright (C) 2016 Ryan M. Richard
+ * 
+ *   This file is part of LibTaskForce.
+ *
+ *   LibTaskForce is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LibTaskForce is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LibTaskForce.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+/** \file Combinators.hpp
+ *  \brief Functions for waiting on several futures at once
+ *  \author Ryan M. Richard
+ *  \version 1.0
+ *  \date October 17, 2026
+ */
+
+#ifndef LIBTASKFORCE_GUARD_COMBINATORS_HPP
+#define LIBTASKFORCE_GUARD_COMBINATORS_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <iterator>
+#include <vector>
+#include "LibTaskForce/Util/ParallelAssert.hpp"
+
+namespace LibTaskForce {
+
+/** \brief Hands out the indices of a set of futures in the order in which
+ *         the futures become ready
+ * 
+ *  Calling get() on a vector of futures in order means one slow early task
+ *  holds up everything behind it.  Iterating over an AsCompleted instead
+ *  lets you deal with each result as soon as it is available:
+ * 
+ *  \code
+ *  std::vector<ThreadFuture<double>> Futures=...;
+ *  for(size_t i:as_completed(Futures))
+ *      use(Futures[i].get());
+ *  \endcode
+ * 
+ *  Works with any future type that has valid(), is_ready(), and wait_for().
+ *  Futures that are not valid() (i.e. whose value was already taken) are
+ *  skipped.  While nothing is ready we wait on the oldest pending future,
+ *  for at most PollTime at a time, and then look at all of them again.
+ *  For ThreadFutures that wait runs other tasks, so progress is made even
+ *  when the caller is the only thread.
+ * 
+ *  \note Process futures are ready once add_task() returns, so for them
+ *  the order is always the order of the vector, which is what keeps
+ *  collective calls like get() in the same order on every process.
+ */
+template<typename FutureType>
+class AsCompleted{
+private:
+    ///Marks that there are no more futures
+    static const size_t Done=static_cast<size_t>(-1);
+    
+    std::vector<FutureType>* Futures_;///< The futures we are watching
+    std::vector<size_t> Pending_;///< Indices we have not handed out yet
+    size_t Current_;///< The index we are currently on
+    bool Started_;///< True once begin() has been called
+    
+    ///Blocks until a pending future is ready and makes it the current one
+    void advance()
+    {
+        if(Pending_.empty()){
+            Current_=Done;
+            return;
+        }
+        while(true){
+            for(auto Itr=Pending_.begin();Itr!=Pending_.end();++Itr){
+                if(!(*Futures_)[*Itr].is_ready())continue;
+                Current_=*Itr;
+                Pending_.erase(Itr);
+                return;
+            }
+            (*Futures_)[Pending_.front()].wait_for(PollTime);
+        }
+    }
+public:
+    ///Longest we wait on one future before checking the others again
+    static constexpr std::chrono::microseconds PollTime=
+        std::chrono::microseconds(100);
+    
+    ///An input iterator over indices into the vector of futures
+    class iterator{
+    private:
+        AsCompleted* Parent_;///< NULL for the end iterator
+        size_t index()const{return Parent_?Parent_->Current_:Done;}
+    public:
+        using iterator_category=std::input_iterator_tag;
+        using value_type=size_t;
+        using difference_type=std::ptrdiff_t;
+        using pointer=const size_t*;
+        using reference=size_t;
+        
+        iterator(AsCompleted* Parent=nullptr):Parent_(Parent){}
+        size_t operator*()const{return index();}
+        iterator& operator++()
+        {
+            Parent_->advance();
+            return *this;
+        }
+        bool operator==(const iterator& Other)const
+        {
+            return index()==Other.index();
+        }
+        bool operator!=(const iterator& Other)const{return !(*this==Other);}
+    };
+    
+    AsCompleted(std::vector<FutureType>& Futures):
+        Futures_(&Futures),Current_(Done),Started_(false)
+    {
+        for(size_t i=0;i<Futures.size();++i)
+            if(Futures[i].valid())Pending_.push_back(i);
+    }
+    
+    ///Blocks until the first future is ready
+    iterator begin()
+    {
+        if(!Started_){
+            Started_=true;
+            advance();
+        }
+        return iterator(this);
+    }
+    iterator end(){return iterator();}
+};
+
+template<typename FutureType>
+constexpr std::chrono::microseconds AsCompleted<FutureType>::PollTime;
+
+///Makes an AsCompleted for \p Futures
+template<typename FutureType>
+AsCompleted<FutureType> as_completed(std::vector<FutureType>& Futures)
+{
+    return AsCompleted<FutureType>(Futures);
+}
+
+/** \brief Waits for any of \p Futures to be ready
+ * 
+ *  \return The index of a ready future (the lowest one if several are), or
+ *          Futures.size() if none of them are valid()
+ */
+template<typename FutureType>
+size_t when_any(std::vector<FutureType>& Futures)
+{
+    AsCompleted<FutureType> Waiter(Futures);
+    const size_t Index=*Waiter.begin();
+    return Index==*Waiter.end()?Futures.size():Index;
+}
+
+/** \brief Waits for all of \p Futures and returns their values in order
+ * 
+ *  The futures are consumed, so all of them must be valid() (unlike
+ *  as_completed() and when_any(), which skip the others).  Backends for which a single collective is
+ *  cheaper than one per future (ProcessFuture, HybridFuture) overload this.
+ */
+template<typename FutureType>
+auto when_all(std::vector<FutureType>& Futures)
+    ->std::vector<decltype(Futures[0].get())>
+{
+    for(const FutureType& Future:Futures)
+        PARALLEL_ASSERT(Future.valid(),"A future's value was already taken");
+    AsCompleted<FutureType> Waiter(Futures);
+    for(auto Itr=Waiter.begin();Itr!=Waiter.end();++Itr);
+    std::vector<decltype(Futures[0].get())> Values;
+    Values.reserve(Futures.size());
+    for(FutureType& Future:Futures)Values.push_back(Future.get());
+    return Values;
+}
+
+}//End namespace LibTaskForce
+#endif /* LIBTASKFORCE_GUARD_COMBINATORS_HPP */
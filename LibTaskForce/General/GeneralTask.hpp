@@ -29,24 +29,38 @@
 #ifndef LIBTASKFORCE_GUARD_GENERALTASK_HPP
 #define LIBTASKFORCE_GUARD_GENERALTASK_HPP
 
+#include <type_traits>
+#include <utility>
+
 namespace LibTaskForce {
 
+/** \brief Code factorization for the tasks of the various backends
+ * 
+ *  The functor is stored by value.  Tasks are moved, never copied, on their
+ *  way to the scheduler, so move-only functors are fine.
+ */
 template<typename T,typename functor_type,typename comm_type>
 struct Task {
+    ///The type we store the functor as (functor_type may be a reference)
+    using stored_type=typename std::decay<functor_type>::type;
+    
     comm_type& CurrentComm_;
     
-    std::shared_ptr<functor_type> Fxn_;
+    ///Mutable so functors with a non-const operator() still work
+    mutable stored_type Fxn_;
     
     virtual ~Task(){}
     
     Task(functor_type&& Fxn,comm_type& Comm) :
        CurrentComm_(Comm),
-       Fxn_(std::make_shared<functor_type>(std::forward<functor_type>(Fxn)))
+       Fxn_(std::forward<functor_type>(Fxn))
     {}
     
+    Task(Task&&)=default;
+    
     virtual T operator()()const{
         std::unique_ptr<comm_type> Comm=this->CurrentComm_.split();
-        return this->Fxn_->operator()(*Comm);
+        return this->Fxn_(*Comm);
     }
     
     
@@ -0,0 +1,46 @@
+/*  
+ *   LibTaskForce: An open-source library for task-based parallelism
+ * 
+ *   Copyright (C) 2016 Ryan M. Richard
+ * 
+ *   This file is part of LibTaskForce.
+ *
+ *   LibTaskForce is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LibTaskForce is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LibTaskForce.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+/** \file GraphNode.hpp
+ *  \brief Handles to the nodes of task graphs
+ *  \author Ryan M. Richard
+ *  \version 1.0
+ *  \date October 17, 2026
+ */
+
+#ifndef LIBTASKFORCE_GUARD_GRAPHNODE_HPP
+#define LIBTASKFORCE_GUARD_GRAPHNODE_HPP
+
+#include <cstddef>
+
+namespace LibTaskForce {
+
+///Identifies a node of a task graph, regardless of what it returns
+struct GraphNodeBase{
+    size_t Index_;///< The node's position in its graph
+};
+
+///Identifies a node of a task graph whose functor returns a \p T
+template<typename T>
+struct GraphNode:public GraphNodeBase{};
+
+}//End namespace LibTaskForce
+#endif /* LIBTASKFORCE_GUARD_GRAPHNODE_HPP */
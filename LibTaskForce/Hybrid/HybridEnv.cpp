@@ -19,21 +19,65 @@
  *   along with LibTaskForce.  If not, see <http://www.gnu.org/licenses/>.
  */ 
 
+#include <vector>
 #include "LibTaskForce/Hybrid/HybridEnv.hpp"
+#include "LibTaskForce/Threading/NumaTopology.hpp"
 #include "LibTaskForce/Threading/ThreadEnv.hpp"
 #include "LibTaskForce/Distributed/ProcessEnv.hpp"
 
 namespace LibTaskForce{
 
-HybridEnv::HybridEnv(size_t NThreads):
-    HybridEnv(MPI_COMM_WORLD,NThreads)
+///Affinity masks are compared on CPUs below this many (Linux's CPU_SETSIZE)
+static const size_t MaxCpus=1024;
+
+///The number of processes of \p Comm on our node whose CPU affinity masks
+///overlap ours (including us), collective.  \p MyIndex is set to how many
+///of them come before us.
+static size_t ranks_sharing_cpus(MPI_Comm Comm,size_t& MyIndex)
+{
+    const NumaTopology Topology;
+    std::vector<unsigned char> Mask(MaxCpus/8,0);
+    for(size_t Node=0;Node<Topology.size();++Node)
+        for(size_t Cpu:Topology.cpus(Node))
+            if(Cpu<MaxCpus)Mask[Cpu/8]|=static_cast<unsigned char>(1u<<(Cpu%8));
+    int Rank,LocalRank,NLocal;
+    MPI_Comm_rank(Comm,&Rank);
+    MPI_Comm Local;
+    MPI_Comm_split_type(Comm,MPI_COMM_TYPE_SHARED,Rank,MPI_INFO_NULL,&Local);
+    MPI_Comm_rank(Local,&LocalRank);
+    MPI_Comm_size(Local,&NLocal);
+    std::vector<unsigned char> Masks(Mask.size()*static_cast<size_t>(NLocal));
+    MPI_Allgather(Mask.data(),static_cast<int>(Mask.size()),MPI_UNSIGNED_CHAR,
+                  Masks.data(),static_cast<int>(Mask.size()),MPI_UNSIGNED_CHAR,
+                  Local);
+    MPI_Comm_free(&Local);
+    size_t NSharing=0;
+    MyIndex=0;
+    for(size_t i=0;i<Masks.size();i+=Mask.size())
+        for(size_t j=0;j<Mask.size();++j)
+            if(Mask[j]&Masks[i+j]){
+                if(i<static_cast<size_t>(LocalRank)*Mask.size())++MyIndex;
+                ++NSharing;
+                break;
+            }
+    return NSharing;
+}
+
+HybridEnv::HybridEnv(size_t NThreads,Engines Engine,Pinnings Pinning):
+    HybridEnv(MPI_COMM_WORLD,NThreads,Engine,Pinning)
     {}
 
 
-HybridEnv::HybridEnv(MPI_Comm Comm,size_t NThreads) :
-    ThreadEnv_(new ThreadEnv(NThreads)), 
+HybridEnv::HybridEnv(MPI_Comm Comm,size_t NThreads,Engines Engine,
+                     Pinnings Pinning) :
     ProcessEnv_(new ProcessEnv(Comm))
 {
+    size_t NSharing=1,MyIndex=0;
+    if(!NThreads || Pinning==PIN_THREADS)
+        NSharing=ranks_sharing_cpus(Comm,MyIndex);
+    if(!NThreads)NThreads=ThreadEnv::default_size(NSharing);
+    //Processes sharing CPUs pin to consecutive, disjoint parts of the spread
+    ThreadEnv_.reset(new ThreadEnv(NThreads,Engine,Pinning,MyIndex*NThreads));
     FirstComm_=std::unique_ptr<HybridComm>(new HybridComm(this));
 }
 
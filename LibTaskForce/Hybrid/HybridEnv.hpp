@@ -33,6 +33,7 @@
 #include<memory>
 #include "LibTaskForce/General/GeneralEnv.hpp"
 #include "LibTaskForce/Hybrid/HybridComm.hpp"
+#include "LibTaskForce/Threading/ThreadEnv.hpp"
 
 namespace LibTaskForce {
 class ThreadEnv;
@@ -43,14 +44,32 @@ class HybridComm;
 class HybridEnv : public GeneralEnv<HybridComm> {
 private:
     friend HybridComm;///<Allows HybridComms to register themselves
+    ///The processes we own, first as the threads' default size needs MPI
+    std::unique_ptr<ProcessEnv> ProcessEnv_;
     std::unique_ptr<ThreadEnv> ThreadEnv_;///<The threads we own
-    std::unique_ptr<ProcessEnv> ProcessEnv_;///<The processes we own
 public:
-    ///For creating a new MPI environment
-    HybridEnv(size_t NThreads=0);
+    /** \brief For creating a new MPI environment
+     * 
+     *  \param[in] NThreads The number of threads per process.  The default,
+     *                      0, splits the CPUs of each node between the
+     *                      processes that share them (those of \p Comm on
+     *                      the node whose affinity masks overlap), so that
+     *                      several processes per node don't oversubscribe
+     *                      it.
+     *  \param[in] Engine   Which scheduler runs the threads' tasks
+     *  \param[in] Pinning  Whether to pin the workers.  Processes that share
+     *                      CPUs each take their own part of the spread (see
+     *                      ThreadEnv::ThreadEnv()), so their workers don't
+     *                      end up on the same CPUs.
+     * 
+     *  Using 0 threads or PIN_THREADS makes this constructor collective.
+     */
+    HybridEnv(size_t NThreads=0,Engines Engine=TBB_ENGINE,
+              Pinnings Pinning=NO_PINNING);
         
-    ///Latches onto existing MPI environment
-    HybridEnv(MPI_Comm Comm,size_t NThreads=0);
+    ///Latches onto existing MPI environment, see HybridEnv(size_t)
+    HybridEnv(MPI_Comm Comm,size_t NThreads=0,Engines Engine=TBB_ENGINE,
+              Pinnings Pinning=NO_PINNING);
     
 };
 
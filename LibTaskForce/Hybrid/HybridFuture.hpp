@@ -31,6 +31,10 @@
 
 #include "LibTaskForce/Threading/ThreadFuture.hpp"
 #include "LibTaskForce/Distributed/ProcessFuture.hpp"
+#include <chrono>
+#include <type_traits>
+#include <vector>
+#include "LibTaskForce/General/Combinators.hpp"
 
 namespace LibTaskForce {
 
@@ -49,20 +53,84 @@ class HybridFuture {
     thread_ptr TF_;
     process_ptr PF_;
     friend class HybridComm;
+    template<typename> friend class HybridFuture;
     HybridFuture(process_ptr PF,thread_ptr TF) :
         TF_(std::move(TF)),PF_(std::move(PF))
     {}
 public:
     HybridFuture()=default;
+    
+    ///Readiness queries, forwarded to the future we hold
+    ///@{
+    bool valid()const
+    {
+        return PF_?PF_->valid():(TF_ && TF_->valid());
+    }
+    bool is_ready()const
+    {
+        return PF_?PF_->is_ready():TF_->is_ready();
+    }
+    template<typename Rep,typename Period>
+    bool wait_for(const std::chrono::duration<Rep,Period>& Timeout)
+    {
+        return PF_?PF_->wait_for(Timeout):TF_->wait_for(Timeout);
+    }
+    ///@}
+    
     ///Returns the object this future holds, blocks if not available
     T get()
     {
         if(PF_)return PF_->get();
         return TF_->get();
     }
+    
+    ///Returns a reference to the object this future holds, for repeated reads
+    const T& value()
+    {
+        if(PF_)return PF_->value();
+        return TF_->value();
+    }
+    
+    ///Schedules \p Fxn on the future we hold, see the backends' then()
+    template<typename FxnType>
+    HybridFuture<typename std::result_of<FxnType(T)>::type>
+    then(FxnType&& Fxn)
+    {
+        using return_type=typename std::result_of<FxnType(T)>::type;
+        using result_type=HybridFuture<return_type>;
+        if(PF_)return result_type(
+            typename result_type::process_ptr(new ProcessFuture<return_type>(
+                PF_->then(std::forward<FxnType>(Fxn)))),nullptr);
+        return result_type(nullptr,typename result_type::thread_ptr(
+            new ThreadFuture<return_type>(TF_->then(std::forward<FxnType>(Fxn)))));
+    }
         
+    
+    template<typename U>
+    friend std::vector<U> when_all(std::vector<HybridFuture<U>>& Futures);
 };
 
+/** \brief Overload of when_all() for a vector of hybrid futures
+ * 
+ *  Futures from a HybridComm are either all process futures or all thread
+ *  futures.  The former are gathered in one collective (see
+ *  ProcessFuture::gather()).
+ */
+template<typename T>
+std::vector<T> when_all(std::vector<HybridFuture<T>>& Futures)
+{
+    for(const HybridFuture<T>& Future:Futures)
+        PARALLEL_ASSERT(Future.valid(),"A future's value was already taken");
+    if(Futures.empty()||!Futures[0].PF_){
+        std::vector<ThreadFuture<T>> TFs;
+        for(HybridFuture<T>& Future:Futures)TFs.push_back(std::move(*Future.TF_));
+        return when_all(TFs);
+    }
+    std::vector<ProcessFuture<T>*> PFs;
+    for(HybridFuture<T>& Future:Futures)PFs.push_back(Future.PF_.get());
+    return ProcessFuture<T>::gather(PFs);
+}
+
 
 }//End namespace LIbTaskForce
 #endif /* LIBTASKFORCE_GUARD_HYBRIDFUTURE_HPP */
@@ -30,18 +30,24 @@
 #define LIBTASKFORCE_GUARD_LIBTASKFORCE_HPP
 
 #include "LibTaskForce/Threading/ThreadEnv.hpp"
+#include "LibTaskForce/Threading/NumaTopology.hpp"
 #include "LibTaskForce/Threading/ThreadComm.hpp"
 #include "LibTaskForce/Threading/ThreadFuture.hpp"
+#include "LibTaskForce/Threading/ThreadScratch.hpp"
+#include "LibTaskForce/Threading/TaskGraph.hpp"
 
 #include "LibTaskForce/Distributed/ProcessEnv.hpp"
 #include "LibTaskForce/Distributed/ProcessComm.hpp"
 #include "LibTaskForce/Distributed/ProcessFuture.hpp"
+#include "LibTaskForce/Distributed/ProcessGraph.hpp"
 
 #include "LibTaskForce/Hybrid/HybridEnv.hpp"
 #include "LibTaskForce/Hybrid/HybridComm.hpp"
 #include "LibTaskForce/Hybrid/HybridFuture.hpp"
 #include "LibTaskForce/Hybrid/HybridQueue.hpp"
 
+#include "LibTaskForce/General/Combinators.hpp"
+
 #include "LibTaskForce/Util/pragma.h"
 
 PRAGMA_WARNING_PUSH
@@ -24,6 +24,7 @@
 #include <iostream>
 #include <cassert>
 #include <cmath>
+#include <numeric>
 #include "LibTaskForce/LibTaskForce.hpp"
 #include "LibTaskForce/Tests/MMTask.hpp"
 
@@ -62,12 +63,55 @@ int main(int argc,char** argv){
     t0=tbb::tick_count::now();
     for(size_t i=0;i<M*M;++i)
         DistTemp[i]=std::move(Comm->add_task<Matrix_t>(MMTask(N,M,i,Matrix)));
-    for(size_t i=0;i<M*M;++i)DistBuffer[i]=DistTemp[i].get();
+    DistBuffer=when_all(DistTemp);
     t1=tbb::tick_count::now();
     DistTime=(t1-t0).seconds();
     
     const double TwoNorm=MMError(N,M,DistBuffer,SerialBuffer);
     AllPassed=(AllPassed&& TwoNorm<1e-6);
+    
+    //Repeated reads only communicate once, get() then takes the value
+    ProcessFuture<Matrix_t> First=Comm->add_task<Matrix_t>(MMTask(N,M,0,Matrix));
+    const Matrix_t& Ref=First.value();
+    AllPassed=(AllPassed&& Ref==SerialBuffer[0] && &First.value()==&Ref);
+    AllPassed=(AllPassed&& First.get()==SerialBuffer[0] && !First.valid());
+    
+    //Continuations: sum each block on its owner, only the sums get sent
+    for(size_t i=0;i<M*M;++i){
+        ProcessFuture<double> Sum=
+            Comm->add_task<Matrix_t>(MMTask(N,M,i,Matrix)).then(
+                [](const Matrix_t& Block){
+                    return std::accumulate(Block.begin(),Block.end(),0.0);
+                });
+        const double Expected=std::accumulate(SerialBuffer[i].begin(),
+                                              SerialBuffer[i].end(),0.0);
+        AllPassed=(AllPassed&& std::fabs(Sum.get()-Expected)<1e-6);
+    }
+    
+    //The same blocks plus their total as a graph, recorded once, run thrice
+    {
+        ProcessGraph Graph(*Comm);
+        std::vector<GraphNode<Matrix_t>> BlockNodes;
+        for(size_t i=0;i<M*M;++i)
+            BlockNodes.push_back(Graph.add_node<Matrix_t>(MMTask(N,M,i,Matrix)));
+        GraphNode<double> Total=Graph.add_node<double>(
+            [&Graph,&BlockNodes](ProcessComm&){
+                double Sum=0.0;
+                for(const GraphNode<Matrix_t>& Bi:BlockNodes)
+                    Sum=std::accumulate(Graph.value(Bi).begin(),
+                                        Graph.value(Bi).end(),Sum);
+                return Sum;
+            });
+        for(const GraphNode<Matrix_t>& Bi:BlockNodes)Graph.add_edge(Bi,Total);
+        double Expected=0.0;
+        for(const Matrix_t& Bi:SerialBuffer)
+            Expected=std::accumulate(Bi.begin(),Bi.end(),Expected);
+        for(size_t Run=0;Run<3;++Run){
+            Graph.run();
+            AllPassed=(AllPassed&& std::fabs(Graph.bcast(Total)-Expected)<1e-6);
+        }
+    }
+    
     if(NewComm.rank()==0)
         std::cout<<"Standard deviation between resulting matrices: "
                   <<TwoNorm<<std::endl;
@@ -24,6 +24,7 @@
 #include <iostream>
 #include <cassert>
 #include <cmath>
+#include <numeric>
 #include "LibTaskForce/LibTaskForce.hpp"
 #include "LibTaskForce/Tests/MMTask.hpp"
 
@@ -42,6 +43,11 @@ int main(int argc,char** argv){
     const HybridComm& NewComm=World->comm();
     std::unique_ptr<HybridComm> Comm=NewComm.split();
     
+    //By default the processes on a node split its CPUs
+    if(!NThreads)
+        AllPassed=(AllPassed&& NewComm.nthreads()>=1 &&
+                   NewComm.nthreads()<=NumaTopology().ncpus());
+    
     if(NewComm.rank()==0)
         std::cout<<"NProcesses: "<<NewComm.nprocs()<<std::endl
                  <<"NThreads:   "<<NewComm.nthreads()<<std::endl
@@ -64,13 +70,25 @@ int main(int argc,char** argv){
     t0=tbb::tick_count::now();
     for(size_t i=0;i<M*M;++i)
         DistTemp[i]=std::move(Comm->add_task<Matrix_t>(MMTask(N,M,i,Matrix)));
-    for(size_t i=0;i<M*M;++i)DistBuffer[i]=DistTemp[i].get();
+    DistBuffer=when_all(DistTemp);
     t1=tbb::tick_count::now();
     DistTime=(t1-t0).seconds();
     
     const double TwoNorm=MMError(N,M,DistBuffer,SerialBuffer);
     AllPassed=(AllPassed&& TwoNorm<1e-6);
     
+    //Continuations: sum each block where it was computed
+    for(size_t i=0;i<M*M;++i){
+        HybridFuture<double> Sum=
+            Comm->add_task<Matrix_t>(MMTask(N,M,i,Matrix)).then(
+                [](const Matrix_t& Block){
+                    return std::accumulate(Block.begin(),Block.end(),0.0);
+                });
+        const double Expected=std::accumulate(SerialBuffer[i].begin(),
+                                              SerialBuffer[i].end(),0.0);
+        AllPassed=(AllPassed&& std::fabs(Sum.get()-Expected)<1e-6);
+    }
+    
     if(NewComm.rank()==0)
         std::cout<<"Standard deviation between resulting matrices: "
                   <<TwoNorm<<std::endl;
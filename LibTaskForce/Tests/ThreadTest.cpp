@@ -19,12 +19,20 @@
  *   along with LibTaskForce.  If not, see <http://www.gnu.org/licenses/>.
  */ 
 
+#include <algorithm>
 #include <vector>
 #include <cstdlib>
 #include <iostream>
+#include <list>
+#include <map>
 #include <memory>
 #include <numeric>
+#include <thread>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <future>
 #include "LibTaskForce/LibTaskForce.hpp"
 
 const std::array<size_t,39> FibNums={
@@ -57,6 +65,699 @@ struct FibTask{
     }
 };
 
+//Fibonacci without tasks, the baseline for the task overhead
+size_t SerialFib(size_t N)
+{
+    return N<2?N:SerialFib(N-1)+SerialFib(N-2);
+}
+
+//Computes the N-th Fibonacci number on Comm and returns the wall time
+double RunFib(ThreadComm& Comm,size_t N)
+{
+    tbb::tick_count t0=tbb::tick_count::now();
+    ThreadFuture<size_t> DaNum=Comm.add_task<size_t>(FibTask(N));
+    size_t Num=DaNum.get();
+    tbb::tick_count t1=tbb::tick_count::now();
+    if(FibNums[N]!=Num)
+        throw std::runtime_error("Fibonacci number was wrong\n");
+    return (t1-t0).seconds();
+}
+
+//Task that always fails (tests that exceptions reach continuations)
+struct ThrowTask{
+    size_t operator()(ThreadComm&)const
+    {
+        throw std::runtime_error("ThrowTask threw");
+    }
+};
+
+//Chains continuations onto Fibonacci tasks and checks the results
+void TestThen(ThreadComm& Comm,size_t N)
+{
+    ThreadFuture<double> Half=Comm.add_task<size_t>(FibTask(N))
+        .then([](size_t x){return 2*x+1;})
+        .then([](size_t x){return (double)x/2.0;});
+    std::vector<ThreadFuture<size_t>> Chains;
+    for(size_t i=0;i<N;++i)
+        Chains.push_back(Comm.add_task<size_t>(FibTask(i))
+            .then([i](size_t x){return x+FibNums[i+1];}));
+    for(size_t i=0;i<N;++i)
+        if(Chains[i].get()!=FibNums[i+2])
+            throw std::runtime_error("Continuation gave the wrong value\n");
+    if(std::fabs(Half.get()-((double)FibNums[N]+0.5))>1e-10)
+        throw std::runtime_error("Chained continuations gave the wrong value\n");
+    bool Caught=false;
+    ThreadFuture<size_t> Bad=Comm.add_task<size_t>(ThrowTask())
+        .then([](size_t x){return x;});
+    try{Bad.get();}
+    catch(const std::runtime_error&){Caught=true;}
+    if(!Caught)
+        throw std::runtime_error("Continuation swallowed an exception\n");
+}
+
+//Task with a move-only result (tests that results are never copied)
+struct UniqueTask{
+    size_t N_;
+    std::unique_ptr<size_t> operator()(ThreadComm&)const
+    {
+        return std::unique_ptr<size_t>(new size_t(FibNums[N_]));
+    }
+};
+
+//Checks value() and get() on move-only results, directly and via then()
+void TestMoveOnly(ThreadComm& Comm,size_t N)
+{
+    ThreadFuture<std::unique_ptr<size_t>> Ptr=
+        Comm.add_task<std::unique_ptr<size_t>>(UniqueTask{N});
+    const size_t* Address=Ptr.value().get();
+    if(*Ptr.value()!=FibNums[N] || Ptr.value().get()!=Address)
+        throw std::runtime_error("value() gave the wrong value\n");
+    std::unique_ptr<size_t> Taken=Ptr.get();
+    if(Taken.get()!=Address || Ptr.valid())
+        throw std::runtime_error("get() did not move the value out\n");
+    ThreadFuture<std::unique_ptr<size_t>> Doubled=
+        Comm.add_task<std::unique_ptr<size_t>>(UniqueTask{N}).then(
+            [](std::unique_ptr<size_t> x){*x*=2;return x;});
+    if(*Doubled.get()!=2*FibNums[N])
+        throw std::runtime_error("then() gave the wrong value\n");
+}
+
+//A result that wants a cache line of its own
+struct alignas(64) LineValue{
+    size_t Value_;
+};
+
+#ifdef __cpp_aligned_new
+//A result aligned beyond what the FramePool gives
+struct alignas(256) PageValue{
+    size_t Value_;
+};
+#endif
+
+//True if Ptr is a multiple of Align
+bool is_aligned(const void* Ptr,size_t Align)
+{
+    return !(reinterpret_cast<std::uintptr_t>(Ptr)%Align);
+}
+
+//Checks that over-aligned results (and so their frames) are aligned
+void TestAlignment(ThreadComm& Comm,size_t N)
+{
+    std::vector<ThreadFuture<LineValue>> Lines;
+    for(size_t i=0;i<100;++i)
+        Lines.push_back(Comm.add_task<LineValue>(
+            [N](ThreadComm&){return LineValue{FibNums[N]};},GRAIN_COARSE));
+    Lines.push_back(Comm.add_task<LineValue>(
+        [N](ThreadComm&){return LineValue{FibNums[N]};},GRAIN_COARSE).then(
+            [](LineValue x){return x;}));
+    for(ThreadFuture<LineValue>& Line:Lines)
+        if(!is_aligned(&Line.value(),alignof(LineValue)) ||
+           Line.value().Value_!=FibNums[N])
+            throw std::runtime_error("A result was misaligned\n");
+#ifdef __cpp_aligned_new
+    ThreadFuture<PageValue> Page=Comm.add_task<PageValue>(
+        [N](ThreadComm&){return PageValue{FibNums[N]};},GRAIN_COARSE);
+    if(!is_aligned(&Page.value(),alignof(PageValue)))
+        throw std::runtime_error("A result was misaligned\n");
+#endif
+}
+
+//Checks when_any(), as_completed() and when_all() on Fibonacci tasks
+void TestCombinators(ThreadComm& Comm,size_t N)
+{
+    //Biggest tasks first, so submission order is the worst order to wait in
+    std::vector<ThreadFuture<size_t>> Futures;
+    for(size_t i=0;i<N;++i)
+        Futures.push_back(Comm.add_task<size_t>(FibTask(N-i)));
+    const size_t First=when_any(Futures);
+    if(First>=N || !Futures[First].is_ready())
+        throw std::runtime_error("when_any returned an unready future\n");
+    std::vector<bool> Seen(N,false);
+    for(size_t i:as_completed(Futures)){
+        if(Seen[i] || Futures[i].get()!=FibNums[N-i])
+            throw std::runtime_error("as_completed gave a bad index\n");
+        Seen[i]=true;
+    }
+    if(std::find(Seen.begin(),Seen.end(),false)!=Seen.end())
+        throw std::runtime_error("as_completed skipped a future\n");
+    
+    Futures.clear();
+    for(size_t i=0;i<N;++i)Futures.push_back(Comm.add_task<size_t>(FibTask(i)));
+    Futures.back().wait_for(std::chrono::seconds(0));
+    std::vector<size_t> Values=when_all(Futures);
+    for(size_t i=0;i<N;++i)
+        if(Values[i]!=FibNums[i])
+            throw std::runtime_error("when_all gave the wrong values\n");
+}
+
+//Checks parallel_for over indices and iterators with each partitioner
+void TestParallelFor(ThreadComm& Comm,size_t N)
+{
+    const Partitioners Parts[]=
+        {SIMPLE_PARTITIONER,AUTO_PARTITIONER,AFFINITY_PARTITIONER};
+    for(Partitioners Part:Parts){
+        std::vector<size_t> Squares(N,0);
+        Comm.parallel_for(size_t(0),N,[&](size_t i){Squares[i]=i*i;},Part,16);
+        for(size_t i=0;i<N;++i)
+            if(Squares[i]!=i*i)
+                throw std::runtime_error("parallel_for missed an index\n");
+        Comm.parallel_for(Squares.begin(),Squares.end(),
+            [](std::vector<size_t>::iterator Itr){*Itr+=1;},Part,16);
+        for(size_t i=0;i<N;++i)
+            if(Squares[i]!=i*i+1)
+                throw std::runtime_error("parallel_for missed an iterator\n");
+    }
+}
+
+//Checks inclusive, exclusive and in-place scans against std::partial_sum
+void TestScan(ThreadComm& Comm,size_t N)
+{
+    struct CountTask{
+        size_t operator()(std::vector<size_t>::const_iterator itr)const
+        {
+            return *itr;
+        }
+        size_t operator()(size_t x,size_t y)const{return x+y;}
+    };
+    std::vector<size_t> In(N),Out(N),Corr(N+1,0);
+    for(size_t i=0;i<N;++i)In[i]=i%7;
+    std::partial_sum(In.begin(),In.end(),Corr.begin()+1);
+    size_t Total=Comm.scan<size_t>(CountTask(),In.cbegin(),In.cend(),Out.begin());
+    if(Total!=Corr[N] || !std::equal(Out.begin(),Out.end(),Corr.begin()+1))
+        throw std::runtime_error("Inclusive scan was wrong\n");
+    Total=Comm.scan<size_t>(CountTask(),In.cbegin(),In.cend(),Out.begin(),false);
+    if(Total!=Corr[N] || !std::equal(Out.begin(),Out.end(),Corr.begin()))
+        throw std::runtime_error("Exclusive scan was wrong\n");
+    Comm.scan<size_t>(CountTask(),In.cbegin(),In.cend(),In.begin());
+    if(!std::equal(In.begin(),In.end(),Corr.begin()+1))
+        throw std::runtime_error("In-place scan was wrong\n");
+}
+
+//Checks that a comm split off with NSub threads never uses more than that
+void TestSplit(const ThreadComm& Comm,size_t N,size_t NSub)
+{
+    std::unique_ptr<ThreadComm> Sub=Comm.split(NSub);
+    if(Sub->size()!=(NSub?std::min(NSub,Comm.size()):Comm.size()))
+        throw std::runtime_error("split() made a comm of the wrong size\n");
+    RunFib(*Sub,N);
+    std::atomic<size_t> NActive(0),MaxActive(0);
+    auto Busy=[&](){
+        size_t Now=++NActive,Max=MaxActive.load();
+        while(Now>Max && !MaxActive.compare_exchange_weak(Max,Now));
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        --NActive;
+    };
+    Sub->parallel_for(size_t(0),size_t(64),[&](size_t){Busy();});
+    std::vector<ThreadFuture<int>> Futures;
+    for(size_t i=0;i<64;++i)
+        Futures.push_back(Sub->add_task<int>([&](ThreadComm&){Busy();return 0;},
+                                             GRAIN_COARSE));
+    for(ThreadFuture<int>& Future:Futures)Future.get();
+    if(MaxActive.load()>Sub->size())
+        throw std::runtime_error("A split comm used too many threads\n");
+    //Dropping a comm with an unread future must still run the task and the
+    //ones it spawns
+    std::unique_ptr<ThreadComm> Unread=Comm.split(NSub);
+    Unread->add_task<size_t>(FibTask(std::min<size_t>(N,12)),GRAIN_COARSE);
+}
+
+//A search that cancels its comm once one task finds the answer
+void TestCancel(const ThreadComm& Comm)
+{
+    const size_t NTasks=200,Answer=NTasks-1;
+    std::unique_ptr<ThreadComm> Search=Comm.split();
+    std::unique_ptr<ThreadComm> SubSearch=Search->split(1);
+    std::vector<ThreadFuture<size_t>> Futures;
+    for(size_t i=0;i<NTasks;++i)
+        Futures.push_back(Search->add_task<size_t>([i](ThreadComm& Me){
+            for(size_t Iter=0;Iter<200 && !Me.cancelled();++Iter){
+                if(i==Answer && Iter==10){
+                    Me.cancel();
+                    return i;
+                }
+                SerialFib(15);
+            }
+            return NTasks;
+        },GRAIN_COARSE));
+    size_t NFound=0,NDropped=0;
+    for(size_t Index:as_completed(Futures)){
+        try{
+            if(Futures[Index].get()==Answer)++NFound;
+        }
+        catch(const TaskCancelled&){
+            ++NDropped;
+        }
+    }
+    if(NFound!=1 || !NDropped)
+        throw std::runtime_error("Cancelling didn't drop the queued tasks\n");
+    if(!Search->cancelled() || !SubSearch->cancelled() || Comm.cancelled())
+        throw std::runtime_error("cancel() reached the wrong comms\n");
+    bool Threw=false;
+    try{
+        SubSearch->add_task<size_t>(FibTask(10)).get();
+    }
+    catch(const TaskCancelled&){
+        Threw=true;
+    }
+    if(!Threw)
+        throw std::runtime_error("A cancelled comm still ran a task\n");
+    std::unique_ptr<ThreadComm> Again=Comm.split();
+    RunFib(*Again,15);
+}
+
+//Counts lattice paths across an N by N grid with a wavefront of graph nodes
+void TestTaskGraph(ThreadComm& Comm,size_t N)
+{
+    TaskGraph Graph(Comm);
+    std::vector<GraphNode<size_t>> Nodes;
+    for(size_t i=0;i<N;++i)
+        for(size_t j=0;j<N;++j){
+            auto Paths=[&Graph,&Nodes,i,j,N](ThreadComm&){
+                if(!i || !j)return size_t(1);
+                return Graph.value(Nodes[(i-1)*N+j])+Graph.value(Nodes[i*N+j-1]);
+            };
+            if(!i || !j)Nodes.push_back(Graph.add_node<size_t>(Paths));
+            else Nodes.push_back(Graph.add_node<size_t>(Paths,
+                                 {Nodes[(i-1)*N+j],Nodes[i*N+j-1]}));
+        }
+    //A node that throws and one that reads its value
+    GraphNode<size_t> Bad=Graph.add_node<size_t>(ThrowTask());
+    GraphNode<size_t> AfterBad=Graph.add_node<size_t>(
+        [&Graph,Bad](ThreadComm&){return Graph.value(Bad);},{Bad});
+    size_t Corr=1;//C(2N-2,N-1)
+    for(size_t k=1;k<N;++k)Corr=Corr*(N-1+k)/k;
+    for(size_t Run=0;Run<3;++Run){
+        Graph.run();
+        if(Graph.value(Nodes.back())!=Corr)
+            throw std::runtime_error("Task graph computed the wrong value\n");
+        Graph.wait();
+        bool Threw=false;
+        try{
+            Graph.value(AfterBad);
+        }
+        catch(const std::runtime_error&){
+            Threw=true;
+        }
+        if(!Threw)
+            throw std::runtime_error("Task graph lost an exception\n");
+    }
+}
+
+//Checks the topology and runs Fibonacci on pinned threads, starting one
+//task on each node
+void TestNuma(size_t NThreads,size_t N)
+{
+    if(NumaTopology::parse_list("0-3,8,10-11")!=
+           std::vector<size_t>({0,1,2,3,8,10,11}) ||
+       NumaTopology::parse_list("5")!=std::vector<size_t>(1,5) ||
+       !NumaTopology::parse_list("3-1").empty())
+        throw std::runtime_error("CPU lists were parsed wrong\n");
+    {
+        ThreadEnv DefaultEnv(0);
+        if(DefaultEnv.size()!=DefaultEnv.topology().ncpus()||
+           ThreadEnv::default_size(DefaultEnv.topology().ncpus()+1)!=1)
+            throw std::runtime_error("Default thread count is wrong\n");
+    }
+    for(Engines Engine:{TBB_ENGINE,NATIVE_ENGINE}){
+        //Pinned as the second of two processes sharing the CPUs would be
+        ThreadEnv PinnedEnv(NThreads,Engine,PIN_THREADS,NThreads);
+        const NumaTopology& Topology=PinnedEnv.topology();
+        if(!Topology.size()||!Topology.ncpus())
+            throw std::runtime_error("Topology has no CPUs\n");
+        for(size_t Node=0;Node<Topology.size();++Node)
+            if(Topology.node_of(Topology.cpus(Node).front())!=Node)
+                throw std::runtime_error("Topology lost track of a CPU\n");
+        std::unique_ptr<ThreadComm> Comm=PinnedEnv.comm().split();
+        RunFib(*Comm,N);
+        std::vector<ThreadFuture<size_t>> Futures;
+        for(size_t Node=0;Node<Topology.size();++Node)
+            Futures.push_back(Comm->add_task_on<size_t>(Node,FibTask(N)));
+        for(size_t Num:when_all(Futures))
+            if(Num!=FibNums[N])
+                throw std::runtime_error("Fibonacci number was wrong on a node\n");
+    }
+}
+
+#ifdef LIBTASKFORCE_HAS_COROUTINES
+//FibTask as a coroutine, waiting on its children frees its thread; if Fail_
+//the N=3 calls await a child that throws
+struct CoFibTask{
+    size_t N_;
+    bool Fail_;
+    CoTask<size_t> operator()(ThreadComm& Comm)const
+    {
+        if(N_<2)co_return N_;
+        if(Fail_ && N_==3)
+            co_await Comm.add_coroutine<size_t>([](ThreadComm&)->CoTask<size_t>{
+                throw std::runtime_error("Coroutine threw");
+                co_return 0;
+            });
+        ThreadFuture<size_t> x=Comm.add_coroutine<size_t>(CoFibTask{N_-1,Fail_});
+        ThreadFuture<size_t> y=Comm.add_coroutine<size_t>(CoFibTask{N_-2,Fail_});
+        co_return co_await x + co_await y;
+    }
+};
+
+//Checks coroutine tasks, also when their children throw
+void TestCoroutines(ThreadComm& Comm,size_t N)
+{
+    if(Comm.add_coroutine<size_t>(CoFibTask{N,false}).get()!=FibNums[N])
+        throw std::runtime_error("Coroutine Fibonacci number was wrong\n");
+    if(N<3)return;
+    bool Threw=false;
+    try{
+        Comm.add_coroutine<size_t>(CoFibTask{N,true},HIGH_PRIORITY).get();
+    }
+    catch(const std::runtime_error&){
+        Threw=true;
+    }
+    if(!Threw)
+        throw std::runtime_error("Coroutine lost an exception\n");
+}
+#endif
+
+//Per iteration cost of an N by N wavefront graph built anew each time or
+//recorded once and replayed
+void TimeGraphReplay(ThreadComm& Comm,size_t N,size_t NIters)
+{
+    auto Record=[&Comm,N](TaskGraph& Graph,std::vector<GraphNode<size_t>>& Nodes){
+        for(size_t i=0;i<N;++i)
+            for(size_t j=0;j<N;++j){
+                auto Sum=[&Graph,&Nodes,i,j,N](ThreadComm&){
+                    return 1+(i?Graph.value(Nodes[(i-1)*N+j]):0)+
+                             (j?Graph.value(Nodes[i*N+j-1]):0);
+                };
+                if(!i || !j)Nodes.push_back(Graph.add_node<size_t>(Sum));
+                else Nodes.push_back(Graph.add_node<size_t>(Sum,
+                                     {Nodes[(i-1)*N+j],Nodes[i*N+j-1]}));
+            }
+    };
+    size_t Total[2]={0,0};
+    tbb::tick_count t0=tbb::tick_count::now();
+    for(size_t Iter=0;Iter<NIters;++Iter){
+        TaskGraph Graph(Comm);
+        std::vector<GraphNode<size_t>> Nodes;
+        Record(Graph,Nodes);
+        Graph.run();
+        Total[0]+=Graph.value(Nodes.back());
+    }
+    tbb::tick_count t1=tbb::tick_count::now();
+    {
+        TaskGraph Graph(Comm);
+        std::vector<GraphNode<size_t>> Nodes;
+        Record(Graph,Nodes);
+        t1=tbb::tick_count::now();
+        for(size_t Iter=0;Iter<NIters;++Iter){
+            Graph.run();
+            Total[1]+=Graph.value(Nodes.back());
+        }
+    }
+    tbb::tick_count t2=tbb::tick_count::now();
+    if(Total[0]!=Total[1])
+        throw std::runtime_error("Replayed graph computed the wrong value\n");
+    std::cout<<"Wavefront of "<<N*N<<" tasks built every iteration (us/iter): "
+             <<1e6*(t1-t0).seconds()/static_cast<double>(NIters)<<std::endl
+             <<"Recorded once and replayed (us/iter): "
+             <<1e6*(t2-t1).seconds()/static_cast<double>(NIters)<<std::endl;
+}
+
+//Histogram of x%NKeys, counting
+struct HistogramTask{
+    size_t NKeys_;
+    std::pair<size_t,size_t> operator()(std::vector<size_t>::const_iterator itr)const
+    {
+        return std::make_pair(*itr%NKeys_,size_t(1));
+    }
+    size_t operator()(size_t x,size_t y)const{return x+y;}
+};
+
+//Checks group_reduce and dense_group_reduce against a serial histogram
+void TestGroupReduce(ThreadComm& Comm,size_t N,size_t NKeys)
+{
+    std::vector<size_t> Data(N),Corr(NKeys,0);
+    for(size_t i=0;i<N;++i){
+        Data[i]=(i*7919)%(3*NKeys+1);
+        ++Corr[Data[i]%NKeys];
+    }
+    std::vector<std::pair<size_t,size_t>> Groups=
+        Comm.group_reduce<size_t,size_t>(HistogramTask{NKeys},
+                                         Data.cbegin(),Data.cend());
+    std::vector<size_t> Counts(NKeys,0);
+    for(const std::pair<size_t,size_t>& Group:Groups){
+        if(Group.first>=NKeys || Counts[Group.first])
+            throw std::runtime_error("group_reduce gave a bad key\n");
+        Counts[Group.first]=Group.second;
+    }
+    if(Counts!=Corr)
+        throw std::runtime_error("group_reduce gave the wrong counts\n");
+    if(Comm.dense_group_reduce<size_t>(HistogramTask{NKeys},
+            Data.cbegin(),Data.cend(),NKeys)!=Corr)
+        throw std::runtime_error("dense_group_reduce gave the wrong counts\n");
+}
+
+//Times std::map, group_reduce and dense_group_reduce histograms
+void TimeGroupReduce(ThreadComm& Comm,size_t N,size_t NKeys)
+{
+    std::vector<size_t> Data(N);
+    for(size_t i=0;i<N;++i)Data[i]=(i*7919)%(3*NKeys+1);
+    tbb::tick_count t0=tbb::tick_count::now();
+    std::map<size_t,size_t> Map;
+    for(size_t x:Data)++Map[x%NKeys];
+    tbb::tick_count t1=tbb::tick_count::now();
+    auto Groups=Comm.group_reduce<size_t,size_t>(HistogramTask{NKeys},
+                                                 Data.cbegin(),Data.cend());
+    tbb::tick_count t2=tbb::tick_count::now();
+    auto Dense=Comm.dense_group_reduce<size_t>(HistogramTask{NKeys},
+                                               Data.cbegin(),Data.cend(),NKeys);
+    tbb::tick_count t3=tbb::tick_count::now();
+    if(Groups.size()!=Map.size() || Dense.size()!=NKeys)
+        throw std::runtime_error("Histograms disagree\n");
+    std::cout<<"Histogram of "<<N<<" values into "<<NKeys<<" keys"<<std::endl
+             <<"std::map wall time: "<<(t1-t0).seconds()<<std::endl
+             <<"group_reduce wall time: "<<(t2-t1).seconds()<<std::endl
+             <<"dense_group_reduce wall time: "<<(t3-t2).seconds()<<std::endl;
+}
+
+//Times repeated sweeps over Vec with each partitioner
+void TimeSweeps(ThreadComm& Comm,std::vector<double>& Vec,size_t NSweeps)
+{
+    const char* Names[]={"simple","auto","affinity"};
+    const size_t N=Vec.size();
+    auto Sweep=[&Vec](size_t i){Vec[i]=0.5*Vec[i]+1.0;};
+    for(size_t Part=0;Part<3;++Part){
+        LoopAffinity Affinity;
+        tbb::tick_count t0=tbb::tick_count::now();
+        for(size_t Iter=0;Iter<NSweeps;++Iter){
+            if(Part==2)Comm.parallel_for(size_t(0),N,Sweep,Affinity,1024);
+            else Comm.parallel_for(size_t(0),N,Sweep,
+                                   Part?AUTO_PARTITIONER:SIMPLE_PARTITIONER,1024);
+        }
+        tbb::tick_count t1=tbb::tick_count::now();
+        std::cout<<"Wall time for "<<NSweeps<<" sweeps with the "<<Names[Part]
+                 <<" partitioner: "<<(t1-t0).seconds()<<std::endl;
+    }
+}
+
+//Time to run a burst of one small task per thread after an idle gap, for
+//each idle policy of the native engine (the pool is warmed up first)
+void TimeIdlePolicies(size_t NThreads,size_t NBursts)
+{
+    const char* Names[]={"sleep","spin","yield"};
+    for(IdlePolicies Policy:{IDLE_SLEEP,IDLE_SPIN,IDLE_YIELD}){
+        ThreadEnv IdleEnv(NThreads,NATIVE_ENGINE);
+        IdleEnv.set_idle_policy(Policy,std::chrono::milliseconds(5));
+        std::unique_ptr<ThreadComm> Comm=IdleEnv.comm().split();
+        IdleEnv.warm_up();
+        double Time=0.0;
+        for(size_t Burst=0;Burst<NBursts;++Burst){
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            tbb::tick_count t0=tbb::tick_count::now();
+            std::vector<ThreadFuture<size_t>> Tasks;
+            for(size_t i=0;i<NThreads;++i)
+                Tasks.push_back(Comm->add_task<size_t>(
+                    [](ThreadComm&){return SerialFib(10);},GRAIN_COARSE));
+            for(ThreadFuture<size_t>& Ti:Tasks)
+                if(Ti.get()!=FibNums[10])
+                    throw std::runtime_error("Burst computed the wrong value\n");
+            Time+=(tbb::tick_count::now()-t0).seconds();
+        }
+        std::cout<<"Burst time after an idle gap, "<<Names[Policy]
+                 <<" policy (us): "<<1e6*Time/static_cast<double>(NBursts)
+                 <<std::endl;
+    }
+}
+
+//A workspace that notices being used by two tasks at once
+struct Workspace{
+    bool InUse_=false;
+    size_t NUses_=0;
+};
+
+//Fibonacci where each task holds a leased workspace while it waits on its
+//children (which may run on the same thread meanwhile) and counts itself
+struct ScratchFibTask{
+    ThreadScratch<Workspace>* Work_;
+    ThreadScratch<size_t>* Counts_;
+    size_t N_;
+    size_t operator()(ThreadComm& Comm)const
+    {
+        ThreadScratch<Workspace>::Lease Work=Work_->lease();
+        if(Work->InUse_)
+            throw std::runtime_error("Scratch object was leased twice\n");
+        Work->InUse_=true;
+        ++Work->NUses_;
+        ++*Counts_->lease();
+        size_t Result=N_;
+        if(N_>=2){
+            ThreadFuture<size_t> x=
+                Comm.add_task<size_t>(ScratchFibTask{Work_,Counts_,N_-1});
+            ThreadFuture<size_t> y=
+                Comm.add_task<size_t>(ScratchFibTask{Work_,Counts_,N_-2});
+            Result=x.get()+y.get();
+        }
+        Work->InUse_=false;
+        return Result;
+    }
+};
+
+//Checks that leases are exclusive and that combining sees every object
+void TestScratch(ThreadComm& Comm,size_t N)
+{
+    std::unique_ptr<ThreadScratch<Workspace>> Work=Comm.make_scratch<Workspace>();
+    std::unique_ptr<ThreadScratch<size_t>> Counts=Comm.make_scratch<size_t>(0);
+    if(Counts->combine(std::plus<size_t>())!=0)
+        throw std::runtime_error("Empty scratch combined wrong\n");
+    for(size_t Run=0;Run<2;++Run){
+        if(Comm.add_task<size_t>(ScratchFibTask{Work.get(),Counts.get(),N}).get()
+           !=FibNums[N])
+            throw std::runtime_error("Fibonacci number was wrong with scratch\n");
+        const size_t NCalls=(Run+1)*(2*FibNums[N+1]-1);
+        size_t NUses=0;
+        Work->combine_each([&NUses](const Workspace& Wi){NUses+=Wi.NUses_;});
+        if(NUses!=NCalls || Counts->combine(std::plus<size_t>())!=NCalls)
+            throw std::runtime_error("Scratch objects lost a use\n");
+    }
+    Work->clear();
+    if(Work->size())throw std::runtime_error("Scratch wasn't cleared\n");
+}
+
+//Per task time (best of NRounds) of tasks that need a large workspace,
+//allocated by each task or leased from per-thread scratch
+void TimeScratch(ThreadComm& Comm,size_t NTasks,size_t Size,size_t NRounds)
+{
+    std::unique_ptr<ThreadScratch<std::vector<double>>> Scratch=
+        Comm.make_scratch(std::vector<double>(Size));
+    auto Fill=[Size](std::vector<double>& Work){
+        for(size_t i=0;i<Size;++i)Work[i]=(double)i;
+        return std::accumulate(Work.begin(),Work.end(),0.0);
+    };
+    double Times[2]={1e300,1e300};
+    for(size_t Round=0;Round<2*NRounds;++Round){
+        const size_t UseScratch=Round%2;
+        tbb::tick_count t0=tbb::tick_count::now();
+        std::vector<ThreadFuture<double>> Tasks;
+        for(size_t i=0;i<NTasks;++i)
+            Tasks.push_back(Comm.add_task<double>(
+                [&Scratch,Fill,Size,UseScratch](ThreadComm&){
+                    if(UseScratch)return Fill(*Scratch->lease());
+                    std::vector<double> Work(Size);
+                    return Fill(Work);
+                },GRAIN_COARSE));
+        for(ThreadFuture<double>& Ti:Tasks)
+            if(std::fabs(Ti.get()-0.5*(double)Size*(double)(Size-1))>1e-6)
+                throw std::runtime_error("Workspace task was wrong\n");
+        Times[UseScratch]=std::min(Times[UseScratch],
+                                   (tbb::tick_count::now()-t0).seconds());
+    }
+    std::cout<<"Tasks with their own workspace (us/task): "
+             <<1e6*Times[0]/static_cast<double>(NTasks)<<std::endl
+             <<"Tasks with a scratch workspace (us/task): "
+             <<1e6*Times[1]/static_cast<double>(NTasks)<<std::endl
+             <<"Speedup: "<<Times[0]/Times[1]<<std::endl;
+}
+
+//Checks warm_up() on both engines, also from inside a task, and that tasks
+//still run when the idle policy changes under them
+void TestIdlePolicies(size_t NThreads,size_t N)
+{
+    for(Engines Engine:{TBB_ENGINE,NATIVE_ENGINE}){
+        ThreadEnv IdleEnv(NThreads,Engine);
+        std::unique_ptr<ThreadComm> Comm=IdleEnv.comm().split();
+        for(IdlePolicies Policy:{IDLE_YIELD,IDLE_SPIN,IDLE_SLEEP}){
+            IdleEnv.set_idle_policy(Policy,std::chrono::microseconds(200));
+            IdleEnv.warm_up();
+            RunFib(*Comm,N);
+        }
+        IdleEnv.set_idle_policy(IDLE_YIELD);
+        std::unique_ptr<ThreadComm> SubComm=IdleEnv.comm().split(2);
+        IdleEnv.warm_up();
+        RunFib(*SubComm,N);
+        //From a task the caller's own worker can't check in, and the others
+        //may be busy, this must not hang
+        Comm->add_task<bool>([&IdleEnv](ThreadComm&){return IdleEnv.warm_up();},
+                             GRAIN_COARSE).get();
+    }
+}
+
+/* Times a chain of NSteps dependent tasks that is started just before
+ * NBackground independent tasks are queued, once with everything at the same
+ * priority and once with the chain at HIGH_PRIORITY and the rest at LOW.
+ */
+void TimePriorities(ThreadComm& Comm,size_t NSteps,size_t NBackground)
+{
+    const size_t Work=20;//Each task computes SerialFib(Work)
+    auto Step=[Work](size_t x){return x+SerialFib(Work);};
+    double Times[2];
+    for(size_t UsePriorities=0;UsePriorities<2;++UsePriorities){
+        const Priorities Critical=UsePriorities?HIGH_PRIORITY:NORMAL_PRIORITY;
+        const Priorities Background=UsePriorities?LOW_PRIORITY:NORMAL_PRIORITY;
+        tbb::tick_count t0=tbb::tick_count::now();
+        ThreadFuture<size_t> Chain=Comm.add_task<size_t>(
+            [Work](ThreadComm&){return SerialFib(Work);},GRAIN_COARSE,Critical);
+        for(size_t i=1;i<NSteps;++i)Chain=Chain.then(Step);
+        std::vector<ThreadFuture<size_t>> Rest;
+        for(size_t i=0;i<NBackground;++i)
+            Rest.push_back(Comm.add_task<size_t>(
+                [Work](ThreadComm&){return SerialFib(Work);},GRAIN_COARSE,
+                Background));
+        if(Chain.get()!=NSteps*FibNums[Work])
+            throw std::runtime_error("Critical path computed the wrong value\n");
+        tbb::tick_count t1=tbb::tick_count::now();
+        for(ThreadFuture<size_t>& Fi:Rest)Fi.get();
+        Times[UsePriorities]=(t1-t0).seconds();
+    }
+    std::cout<<"Critical path time under background load, one priority: "
+             <<Times[0]<<std::endl
+             <<"Critical path time with HIGH over LOW priority: "<<Times[1]
+             <<std::endl<<"Speedup: "<<Times[0]/Times[1]<<std::endl;
+}
+
+//Time per set/get round trip of a std::promise/future pair and a ResultSlot
+void TimeResultHandoff(size_t NTrips)
+{
+    size_t Total=0;
+    tbb::tick_count t0=tbb::tick_count::now();
+    for(size_t i=0;i<NTrips;++i){
+        std::promise<size_t> P;
+        std::future<size_t> F=P.get_future();
+        P.set_value(i);
+        Total+=F.get();
+    }
+    tbb::tick_count t1=tbb::tick_count::now();
+    for(size_t i=0;i<NTrips;++i){
+        ResultSlot<size_t> Slot;
+        Slot.set_value(i);
+        Total-=Slot.get();
+    }
+    tbb::tick_count t2=tbb::tick_count::now();
+    if(Total!=0)
+        throw std::runtime_error("Result handoff lost a value\n");
+    std::cout<<"std::promise handoff (ns/task): "
+             <<1e9*(t1-t0).seconds()/static_cast<double>(NTrips)<<std::endl
+             <<"ResultSlot handoff (ns/task): "
+             <<1e9*(t2-t1).seconds()/static_cast<double>(NTrips)<<std::endl;
+}
+
 //Functor for testing reduce() simply adds numbers together
 struct MyReduceTask{
     double operator()(std::vector<double>::const_iterator itr)const
@@ -91,25 +792,204 @@ int main(int argc,char** argv){
     std::cout<<"NThreads: "<<NewComm->size()<<std::endl;
     std::cout<<"Computing the "<<N<<"-th Fibonacci number"<<std::endl;
     
-    tbb::tick_count t0=tbb::tick_count::now();
-    ThreadFuture<size_t> DaNum=NewComm->add_task<size_t>(FibTask(N));
-    size_t Num=DaNum.get();
-    tbb::tick_count t1=tbb::tick_count::now();
-    std::cout<<"Wall time: "<<(t1-t0).seconds()<<std::endl;
-    if(FibNums[N]!=Num)
-        throw std::runtime_error("Fibonacci number was wrong\n");
+    tbb::tick_count ts0=tbb::tick_count::now();
+    const size_t SerialNum=SerialFib(N);
+    tbb::tick_count ts1=tbb::tick_count::now();
+    if(SerialNum!=FibNums[N])
+        throw std::runtime_error("Serial Fibonacci number was wrong\n");
+    const double SerialTime=(ts1-ts0).seconds();
+    std::cout<<"Serial wall time: "<<SerialTime<<std::endl;
+    
+    const double FibTime=RunFib(*NewComm,N);
+    std::cout<<"Wall time: "<<FibTime<<std::endl
+             <<"Speedup over serial: "<<SerialTime/FibTime<<std::endl;
+    
+    {
+        ThreadEnv NativeEnv(NThreads,NATIVE_ENGINE);
+        std::unique_ptr<ThreadComm> NativeComm=NativeEnv.comm().split();
+        std::cout<<"Computing the "<<N<<"-th Fibonacci number with the "
+                 <<"native engine"<<std::endl;
+        const double NativeTime=RunFib(*NativeComm,N);
+        std::cout<<"Wall time: "<<NativeTime<<std::endl
+                 <<"Speedup over TBB: "<<FibTime/NativeTime<<std::endl
+                 <<"Speedup over serial: "<<SerialTime/NativeTime<<std::endl
+                 <<NativeEnv;
+    }
+    
+    {
+        ThreadEnv NativeEnv(NThreads,NATIVE_ENGINE);
+        std::unique_ptr<ThreadComm> NativeComm=NativeEnv.comm().split();
+        TestThen(*NewComm,std::min<size_t>(N,30));
+        TestThen(*NativeComm,std::min<size_t>(N,30));
+        std::cout<<"Continuations passed"<<std::endl;
+        TestCombinators(*NewComm,std::min<size_t>(N,25));
+        TestCombinators(*NativeComm,std::min<size_t>(N,25));
+        std::cout<<"Combinators passed"<<std::endl;
+        TestMoveOnly(*NewComm,std::min<size_t>(N,30));
+        TestMoveOnly(*NativeComm,std::min<size_t>(N,30));
+        TestAlignment(*NewComm,std::min<size_t>(N,30));
+        TestAlignment(*NativeComm,std::min<size_t>(N,30));
+        std::cout<<"Move-only and aligned results passed"<<std::endl;
+        TestParallelFor(*NewComm,1000);
+        TestParallelFor(*NativeComm,1000);
+        std::cout<<"parallel_for passed"<<std::endl;
+        for(size_t Size:{size_t(0),size_t(1),size_t(1000),size_t(100000)}){
+            TestScan(*NewComm,Size);
+            TestScan(*NativeComm,Size);
+        }
+        std::cout<<"Scans passed"<<std::endl;
+        for(size_t NKeys:{size_t(1),size_t(10),size_t(5000)}){
+            TestGroupReduce(*NewComm,20000,NKeys);
+            TestGroupReduce(*NativeComm,20000,NKeys);
+        }
+        TestGroupReduce(*NewComm,0,3);
+        std::cout<<"Group reductions passed"<<std::endl;
+        for(size_t NSub:{size_t(1),size_t(2),size_t(0)}){
+            TestSplit(*NewComm,std::min<size_t>(N,20),NSub);
+            TestSplit(*NativeComm,std::min<size_t>(N,20),NSub);
+        }
+        std::cout<<"Split comms passed"<<std::endl;
+        TestCancel(*NewComm);
+        TestCancel(*NativeComm);
+        std::cout<<"Cancellation passed"<<std::endl;
+        for(size_t Size:{size_t(1),size_t(12)}){
+            TestTaskGraph(*NewComm,Size);
+            TestTaskGraph(*NativeComm,Size);
+        }
+        std::cout<<"Task graphs passed"<<std::endl;
+#ifdef LIBTASKFORCE_HAS_COROUTINES
+        for(size_t Size:{size_t(2),size_t(std::min<size_t>(N,20))}){
+            TestCoroutines(*NewComm,Size);
+            TestCoroutines(*NativeComm,Size);
+        }
+        std::cout<<"Coroutines passed"<<std::endl;
+#endif
+        TestNuma(NThreads,std::min<size_t>(N,20));
+        std::cout<<"NUMA placement passed"<<std::endl;
+        TestIdlePolicies(NThreads,std::min<size_t>(N,20));
+        std::cout<<"Idle policies passed"<<std::endl;
+        for(size_t Size:{size_t(0),size_t(std::min<size_t>(N,20))}){
+            TestScratch(*NewComm,Size);
+            TestScratch(*NativeComm,Size);
+        }
+        std::cout<<"Scratch storage passed"<<std::endl;
+    }
+    
+    TimePriorities(*NewComm,16,2000);
+    TimeIdlePolicies(NThreads,50);
+    TimeScratch(*NewComm,2000,1<<16,3);
+    TimeGraphReplay(*NewComm,16,200);
+    {
+        ThreadEnv NativeEnv(NThreads,NATIVE_ENGINE);
+        std::unique_ptr<ThreadComm> NativeComm=NativeEnv.comm().split();
+        TimePriorities(*NativeComm,16,2000);
+    }
+    TimeResultHandoff(1000000);
 
     std::vector<double> Vec(SumMax);
     const double Max=(double)SumMax;
     const double TheoryValue=Max*(Max+1.0)/2.0;
     std::iota(Vec.begin(),Vec.end(),1);
     
+    TimeSweeps(*NewComm,Vec,10);
+    TimeGroupReduce(*NewComm,std::min<size_t>(SumMax,10000000),1000);
+    std::iota(Vec.begin(),Vec.end(),1);
+    
     std::cout<<"Computing the sum of the numbers [1,"<<SumMax<<"]"<<std::endl;
-    t0=tbb::tick_count::now();
+    tbb::tick_count t0=tbb::tick_count::now();
     double DaSum=NewComm->reduce<double>(MyReduceTask(),Vec.begin(),Vec.end());
-    t1=tbb::tick_count::now();
+    tbb::tick_count t1=tbb::tick_count::now();
     if(std::fabs(100.0*(DaSum-TheoryValue)/TheoryValue)>1e-5)
         throw std::runtime_error("Summation added up to the wrong value\n");
-    std::cout<<"Wall time: "<<(t1-t0).seconds()<<std::endl;
+    const double ReduceTime=(t1-t0).seconds();
+    std::cout<<"Wall time: "<<ReduceTime<<std::endl;
+    
+    std::cout<<"Computing the same sum deterministically"<<std::endl;
+    t0=tbb::tick_count::now();
+    const double DetSum=NewComm->reduce<double>(MyReduceTask(),Vec.begin(),
+                                                Vec.end(),DETERMINISTIC_REDUCE);
+    t1=tbb::tick_count::now();
+    if(std::fabs(100.0*(DetSum-TheoryValue)/TheoryValue)>1e-5)
+        throw std::runtime_error("Deterministic sum was wrong\n");
+    std::cout<<"Wall time: "<<(t1-t0).seconds()<<std::endl
+             <<"Speedup over the fast mode: "<<ReduceTime/(t1-t0).seconds()
+             <<std::endl;
+    {
+        ThreadEnv NativeEnv(NThreads,NATIVE_ENGINE);
+        std::unique_ptr<ThreadComm> NativeComm=NativeEnv.comm().split();
+        for(size_t Run=0;Run<3;++Run){
+            const double Again=(Run%2?*NativeComm:*NewComm).reduce<double>(
+                MyReduceTask(),Vec.begin(),Vec.end(),DETERMINISTIC_REDUCE);
+            if(std::memcmp(&Again,&DetSum,sizeof(double)))
+                throw std::runtime_error("Deterministic sum was not reproduced\n");
+        }
+    }
+    
+    std::cout<<"Computing the same sum a chunk at a time"<<std::endl;
+    t0=tbb::tick_count::now();
+    DaSum=NewComm->chunk_reduce<double>(SumKernel<double>(),Vec.begin(),Vec.end());
+    t1=tbb::tick_count::now();
+    if(std::fabs(100.0*(DaSum-TheoryValue)/TheoryValue)>1e-5)
+        throw std::runtime_error("Chunked summation added up to the wrong value\n");
+    std::cout<<"Wall time: "<<(t1-t0).seconds()<<std::endl
+             <<"Speedup over reduce: "<<ReduceTime/(t1-t0).seconds()<<std::endl;
+    
+    std::cout<<"Computing the same sum from a generator"<<std::endl;
+    size_t Counter=0;
+    auto Count=[&Counter,SumMax](double& x){
+        x=(double)++Counter;
+        return Counter<=SumMax;
+    };
+    t0=tbb::tick_count::now();
+    DaSum=NewComm->stream_reduce<double,double>(MyReduceTask(),Count);
+    t1=tbb::tick_count::now();
+    if(std::fabs(100.0*(DaSum-TheoryValue)/TheoryValue)>1e-5)
+        throw std::runtime_error("Streamed summation added up to the wrong value\n");
+    std::cout<<"Wall time: "<<(t1-t0).seconds()<<std::endl
+             <<"Speedup over reduce: "<<ReduceTime/(t1-t0).seconds()<<std::endl;
+    {
+        //Forward iterators only, with chunks that don't divide the input
+        const std::list<double> List(Vec.begin(),Vec.begin()+std::min<size_t>(SumMax,10000));
+        const double ListSum=NewComm->stream_reduce<double>(
+            MyReduceTask(),List.begin(),List.end(),7);
+        const double ListMax=(double)List.size();
+        const double ListTheory=ListMax*(ListMax+1.0)/2.0;
+        if(std::fabs((ListSum-ListTheory)/ListTheory)>1e-10)
+            throw std::runtime_error("Streaming a list added up to the wrong value\n");
+    }
+    
+    //Vec is still needed below, so scan a bounded prefix into its own buffer
+    const size_t ScanMax=std::min<size_t>(SumMax,10000000);
+    std::vector<double> Scanned(ScanMax);
+    std::cout<<"Scanning the numbers [1,"<<ScanMax<<"]"<<std::endl;
+    t0=tbb::tick_count::now();
+    std::partial_sum(Vec.begin(),Vec.begin()+ScanMax,Scanned.begin());
+    t1=tbb::tick_count::now();
+    const double SerialScan=(t1-t0).seconds();
+    t0=tbb::tick_count::now();
+    NewComm->scan<double>(MyReduceTask(),Vec.cbegin(),Vec.cbegin()+ScanMax,
+                          Scanned.begin());
+    t1=tbb::tick_count::now();
+    const double ScanTheory=(double)ScanMax*((double)ScanMax+1.0)/2.0;
+    if(std::fabs((Scanned.back()-ScanTheory)/ScanTheory)>1e-10)
+        throw std::runtime_error("Scan added up to the wrong value\n");
+    std::cout<<"Serial wall time: "<<SerialScan<<std::endl
+             <<"Wall time: "<<(t1-t0).seconds()<<std::endl
+             <<"Speedup over serial: "<<SerialScan/(t1-t0).seconds()<<std::endl;
+    
+    //Vec is 1..SumMax, so the extremes and Vec.Vec are known
+    if(SumMax<2)return 0;
+    Vec[0]=-1.0;
+    const double Min=NewComm->chunk_reduce<double>(MinKernel<double>(),
+                                                   Vec.begin(),Vec.end());
+    const double MaxVal=NewComm->chunk_reduce<double>(MaxKernel<double>(),
+                                                      Vec.begin(),Vec.end());
+    Vec[0]=1.0;
+    const double Dot=NewComm->chunk_reduce<double>(
+        DotKernel<double>(Vec.data(),Vec.data()),Vec.begin(),Vec.end());
+    const double TheoryDot=Max*(Max+1.0)*(2.0*Max+1.0)/6.0;
+    if(std::fabs(Min+1.0)>1e-10 || std::fabs((MaxVal-Max)/Max)>1e-10 ||
+       std::fabs((Dot-TheoryDot)/TheoryDot)>1e-10)
+        throw std::runtime_error("Min/max/dot kernels gave the wrong value\n");
     return 0;
 }
@@ -0,0 +1,106 @@
+/*  
+ *   LibTaskForce: An open-source library for task-based parallelism
+ * 
+ *   Copyright (C) 2016 Ryan M. Richard
+ * 
+ *   This file is part of LibTaskForce.
+ *
+ *   LibTaskForce is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LibTaskForce is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LibTaskForce.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+/** \file CancelToken.hpp
+ *  \brief Flags that tell a tree of comms to stop starting tasks
+ *  \author Ryan M. Richard
+ *  \version 1.0
+ *  \date October 17, 2026
+ */
+
+#ifndef LIBTASKFORCE_GUARD_CANCELTOKEN_HPP
+#define LIBTASKFORCE_GUARD_CANCELTOKEN_HPP
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace LibTaskForce {
+
+///What the future of a task that was dropped because of a cancel() throws
+struct TaskCancelled:public std::runtime_error{
+    TaskCancelled():std::runtime_error("The task was cancelled"){}
+};
+
+/** \brief A cancellation flag that is shared by copies and inherited by
+ *         children
+ * 
+ *  Cancelling a token cancels all of its children (and theirs, and so on),
+ *  but not its parent.  Cancelling is rare and polling is frequent, so
+ *  cancel() pushes the flag down the tree and cancelled() is a single load.
+ *  Once cancelled a token stays cancelled; make a new child of an uncancelled
+ *  token to carry on.
+ */
+class CancelToken{
+private:
+    struct State{
+        std::atomic<bool> Cancelled_;///< The flag itself
+        std::mutex Mutex_;///< Guards Children_
+        std::vector<std::weak_ptr<State>> Children_;///< Tokens to pass it on to
+        State():Cancelled_(false){}
+        
+        void cancel()
+        {
+            Cancelled_.store(true);
+            std::lock_guard<std::mutex> Lock(Mutex_);
+            for(std::weak_ptr<State>& Child:Children_)
+                if(std::shared_ptr<State> Ptr=Child.lock())Ptr->cancel();
+            Children_.clear();
+        }
+    };
+    std::shared_ptr<State> State_;///< Shared with our copies
+public:
+    ///Makes a token with no parent
+    CancelToken():State_(std::make_shared<State>()){}
+    
+    ///Makes a token that is cancelled when this one is
+    CancelToken child()const
+    {
+        CancelToken Child;
+        std::lock_guard<std::mutex> Lock(State_->Mutex_);
+        if(State_->Cancelled_.load())Child.State_->Cancelled_.store(true);
+        else{
+            //Drop children that are gone so the list doesn't grow forever
+            std::vector<std::weak_ptr<State>>& Children=State_->Children_;
+            for(size_t i=0;i<Children.size();)
+                if(Children[i].expired()){
+                    Children[i]=std::move(Children.back());
+                    Children.pop_back();
+                }
+                else ++i;
+            Children.push_back(Child.State_);
+        }
+        return Child;
+    }
+    
+    void cancel(){State_->cancel();}///< Cancels us and our children
+    
+    ///True if we, or one of our ancestors, were cancelled
+    bool cancelled()const
+    {
+        return State_->Cancelled_.load(std::memory_order_relaxed);
+    }
+};
+
+}//End namespace LibTaskForce
+#endif /* LIBTASKFORCE_GUARD_CANCELTOKEN_HPP */
@@ -0,0 +1,166 @@
+/*  
+ *   LibTaskForce: An open-source library for task-based parallelism
+ * 
+ *   Copyright (C) 2016 Ryan M. Richard
+ * 
+ *   This file is part of LibTaskForce.
+ *
+ *   LibTaskForce is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LibTaskForce is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LibTaskForce.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+/** \file ChaseLevDeque.hpp
+ *  \brief The lock-free work-stealing deque used by WorkStealingPool
+ *  \author Ryan M. Richard
+ *  \version 1.0
+ *  \date October 17, 2026
+ */
+
+#ifndef LIBTASKFORCE_GUARD_CHASELEVDEQUE_HPP
+#define LIBTASKFORCE_GUARD_CHASELEVDEQUE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace LibTaskForce {
+
+/** \brief A Chase-Lev work-stealing deque
+ * 
+ *  One thread, the owner, pushes and pops at the bottom of the deque (LIFO),
+ *  while any other thread may steal from the top (FIFO).  The owner's
+ *  operations only synchronize with thieves when the deque is almost empty.
+ *  This follows the C11 version of the algorithm by Le, Pop, Cohen, and
+ *  Zappa Nardelli (PPoPP 2013).
+ * 
+ *  The buffer grows when it fills up.  Because a thief may still be reading
+ *  from the old buffer, old buffers are retired rather than freed and are
+ *  only released when the deque is destroyed.
+ * 
+ *  \param[in] T The type of element, must be trivially copyable (we only
+ *               ever store pointers to tasks)
+ */
+template<typename T>
+class ChaseLevDeque{
+private:
+    using index_type=std::int64_t;///< Signed so the empty check works
+    
+    ///A circular buffer whose size is a power of 2
+    struct Buffer{
+        const index_type Size_;///< The number of elements in the buffer
+        std::unique_ptr<std::atomic<T>[]> Data_;///< The elements
+        
+        Buffer(index_type Size):
+            Size_(Size),Data_(new std::atomic<T>[static_cast<size_t>(Size)])
+        {}
+        
+        T get(index_type i)const
+        {
+            return Data_[static_cast<size_t>(i&(Size_-1))].load(
+                    std::memory_order_relaxed);
+        }
+        
+        void put(index_type i,T Value)
+        {
+            Data_[static_cast<size_t>(i&(Size_-1))].store(Value,
+                    std::memory_order_relaxed);
+        }
+    };
+    
+    std::atomic<index_type> Top_;///< Where thieves steal from
+    std::atomic<index_type> Bottom_;///< Where the owner pushes/pops
+    std::atomic<Buffer*> Buffer_;///< The current buffer
+    std::vector<std::unique_ptr<Buffer>> Buffers_;///< Every buffer we made
+    
+    ///Doubles the buffer, only called by the owner
+    Buffer* grow(Buffer* Old,index_type Bottom,index_type Top)
+    {
+        Buffers_.emplace_back(new Buffer(2*Old->Size_));
+        Buffer* New=Buffers_.back().get();
+        for(index_type i=Top;i<Bottom;++i)New->put(i,Old->get(i));
+        Buffer_.store(New,std::memory_order_release);
+        return New;
+    }
+public:
+    ///Makes a deque that can initially hold \p Size elements (power of 2)
+    ChaseLevDeque(size_t Size=256):
+        Top_(0),Bottom_(0)
+    {
+        Buffers_.emplace_back(new Buffer(static_cast<index_type>(Size)));
+        Buffer_.store(Buffers_.back().get(),std::memory_order_relaxed);
+    }
+    
+    ///Deques are shared by address, so they can be neither copied nor moved
+    ///@{
+    ChaseLevDeque(const ChaseLevDeque&)=delete;
+    ChaseLevDeque& operator=(const ChaseLevDeque&)=delete;
+    ///@}
+    
+    ///Adds \p Value to the bottom, may only be called by the owner
+    void push(T Value)
+    {
+        const index_type b=Bottom_.load(std::memory_order_relaxed);
+        const index_type t=Top_.load(std::memory_order_acquire);
+        Buffer* a=Buffer_.load(std::memory_order_relaxed);
+        if(b-t>a->Size_-1)a=grow(a,b,t);
+        a->put(b,Value);
+        std::atomic_thread_fence(std::memory_order_release);
+        Bottom_.store(b+1,std::memory_order_relaxed);
+    }
+    
+    ///Takes the bottom element, may only be called by the owner
+    bool pop(T& Value)
+    {
+        const index_type b=Bottom_.load(std::memory_order_relaxed)-1;
+        Buffer* a=Buffer_.load(std::memory_order_relaxed);
+        Bottom_.store(b,std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        index_type t=Top_.load(std::memory_order_relaxed);
+        bool Found=(t<=b);
+        if(Found){
+            Value=a->get(b);
+            if(t==b){//Last element, race the thieves for it
+                Found=Top_.compare_exchange_strong(t,t+1,
+                        std::memory_order_seq_cst,std::memory_order_relaxed);
+                Bottom_.store(b+1,std::memory_order_relaxed);
+            }
+        }
+        else Bottom_.store(b+1,std::memory_order_relaxed);
+        return Found;
+    }
+    
+    ///Takes the top element, may be called by any thread
+    bool steal(T& Value)
+    {
+        index_type t=Top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const index_type b=Bottom_.load(std::memory_order_acquire);
+        if(t>=b)return false;
+        Buffer* a=Buffer_.load(std::memory_order_acquire);
+        Value=a->get(t);
+        return Top_.compare_exchange_strong(t,t+1,
+                std::memory_order_seq_cst,std::memory_order_relaxed);
+    }
+    
+    ///An estimate of how many elements are in the deque
+    size_t size()const
+    {
+        const index_type b=Bottom_.load(std::memory_order_relaxed);
+        const index_type t=Top_.load(std::memory_order_relaxed);
+        return b>t?static_cast<size_t>(b-t):0;
+    }
+};
+
+}//End namespace LibTaskForce
+#endif /* LIBTASKFORCE_GUARD_CHASELEVDEQUE_HPP */
@@ -0,0 +1,232 @@
+/*  
+ *   LibTaskForce: An open-source library for task-based parallelism
+ * 
+ *   Copyright (C) 2016 Ryan M. Richard
+ * 
+ *   This file is part of LibTaskForce.
+ *
+ *   LibTaskForce is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LibTaskForce is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LibTaskForce.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+/** \file CoTask.hpp
+ *  \brief Tasks that are C++20 coroutines
+ *  \author Ryan M. Richard
+ *  \version 1.0
+ *  \date October 17, 2026
+ */
+
+#ifndef LIBTASKFORCE_GUARD_COTASK_HPP
+#define LIBTASKFORCE_GUARD_COTASK_HPP
+
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#include <exception>
+#include <utility>
+#include "LibTaskForce/Threading/FramePool.hpp"
+#include "LibTaskForce/Threading/ThreadFuture.hpp"
+#include "LibTaskForce/Threading/ThreadQueue.hpp"
+
+///Defined if the compiler supports coroutines, and hence CoTask exists
+#define LIBTASKFORCE_HAS_COROUTINES 1
+
+namespace LibTaskForce {
+
+/** \brief What the functors given to ThreadComm::add_coroutine return
+ * 
+ *  A coroutine task is written like any other task, except that it
+ *  co_awaits the futures of its children (instead of calling get()) and
+ *  co_returns its result:
+ *  \code
+ *  struct CoFib{
+ *      size_t N_;
+ *      CoTask<size_t> operator()(ThreadComm& Comm)const{
+ *          if(N_<2)co_return N_;
+ *          ThreadFuture<size_t> x=Comm.add_coroutine<size_t>(CoFib{N_-1});
+ *          ThreadFuture<size_t> y=Comm.add_coroutine<size_t>(CoFib{N_-2});
+ *          co_return co_await x + co_await y;
+ *      }
+ *  };
+ *  \endcode
+ * 
+ *  If a child is not done, the coroutine is suspended and its thread goes
+ *  off to do other work.  Whichever thread finishes the last awaited child
+ *  resumes it.  Like get(), co_await runs the child right away if no thread
+ *  has started it yet, and it consumes the future.
+ * 
+ *  Coroutine frames come from the FramePool.
+ */
+template<typename T>
+class CoTask{
+public:
+    ///Gives the coroutine's frame back once it has finished
+    struct FinalAwaiter{
+        bool await_ready()const noexcept{return false;}
+        template<typename promise_type>
+        void await_suspend(std::coroutine_handle<promise_type> Handle)noexcept
+        {
+            ResultFrame<T>* Frame=Handle.promise().Frame_;
+            Handle.destroy();
+            Frame->finish();
+            Frame->release();
+        }
+        void await_resume()const noexcept{}
+    };
+    
+    struct promise_type{
+        ResultFrame<T>* Frame_=nullptr;///< Where the result goes
+        
+        CoTask get_return_object()
+        {
+            return CoTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend()const noexcept{return {};}
+        FinalAwaiter final_suspend()const noexcept{return {};}
+        
+        template<typename U>
+        void return_value(U&& Value)
+        {
+            Frame_->Result_.set_value(std::forward<U>(Value));
+        }
+        void unhandled_exception()
+        {
+            Frame_->Result_.set_exception(std::current_exception());
+        }
+        
+        ///Coroutine frames come from the FramePool.  C++20 doesn't pass
+        ///their alignment, but the pool's blocks are cache-line aligned, so
+        ///locals (and awaited results) of up to alignas(64) are fine.
+        ///@{
+        static void* operator new(size_t Size){return FramePool::allocate(Size);}
+        static void operator delete(void* Ptr,size_t Size)
+        {
+            FramePool::deallocate(Ptr,Size);
+        }
+        ///@}
+    };
+    
+    CoTask(CoTask&& Other)noexcept:Handle_(std::exchange(Other.Handle_,nullptr)){}
+    CoTask(const CoTask&)=delete;
+    CoTask& operator=(const CoTask&)=delete;
+    
+    ///Destroys the coroutine if it was never started
+    ~CoTask(){if(Handle_)Handle_.destroy();}
+    
+    /** \brief Runs the coroutine up to its first suspension, after which it
+     *         owns itself
+     * 
+     *  Its result goes to \p Frame, on which it calls finish() and release()
+     *  when it is done.
+     */
+    void start(ResultFrame<T>* Frame)
+    {
+        Handle_.promise().Frame_=Frame;
+        std::exchange(Handle_,nullptr).resume();
+    }
+private:
+    std::coroutine_handle<promise_type> Handle_;///< The unstarted coroutine
+    
+    explicit CoTask(std::coroutine_handle<promise_type> Handle):
+        Handle_(Handle)
+    {}
+};
+
+/** \brief The frame of a coroutine task
+ * 
+ *  The frame is Deferred_: running it only starts the coroutine, which
+ *  finishes the frame when it co_returns.  The coroutine holds a reference
+ *  to the frame until then.
+ */
+template<typename T,typename TaskType>
+struct CoroutineFrame:public ResultFrame<T>{
+    TaskType Task_;///< Makes the coroutine
+    
+    CoroutineFrame(TaskType&& Task,ThreadQueue* Queue):
+        ResultFrame<T>(Queue,true),Task_(std::move(Task))
+    {}
+    
+    void compute()
+    {
+        this->Deferred_=true;
+        ++this->NRefs_;
+        try{
+            Task_().start(this);
+        }
+        catch(...){//The functor threw before it got to be a coroutine
+            this->Result_.set_exception(std::current_exception());
+            this->finish();
+            this->release();
+        }
+    }
+};
+
+///Resumes a suspended coroutine, it is what an awaited task continues with
+struct ResumeFrame:public TaskFrameBase{
+    std::coroutine_handle<> Handle_;///< The suspended coroutine
+    
+    ResumeFrame(std::coroutine_handle<> Handle,ThreadQueue* Queue):
+        TaskFrameBase(Queue,true),Handle_(Handle)
+    {}
+    
+    void compute(){Handle_.resume();}
+    
+    ///Even if its queue was cancelled the coroutine has to finish (it will
+    ///find out from its children's futures)
+    void abandon(){Handle_.resume();}
+};
+
+///What co_await on a ThreadFuture does
+template<typename T>
+struct FutureAwaiter{
+    ThreadFuture<T> Future_;///< What we are waiting on
+    
+    ///Runs the task if nobody has started it, true if it's done
+    bool await_ready()
+    {
+        PARALLEL_ASSERT(Future_.Frame_!=nullptr,
+                        "This future's value was already taken");
+        if(Future_.Frame_->try_run())Future_.Parent_->drop_stale();
+        return Future_.Ready();
+    }
+    
+    ///Schedules the coroutine to be resumed once the task is done, false if
+    ///it already is
+    template<typename promise_type>
+    bool await_suspend(std::coroutine_handle<promise_type> Handle)
+    {
+        TaskFrameBase* Antecedent=Future_.Frame_.get();
+        ResumeFrame* Resume=new ResumeFrame(Handle,Antecedent->Queue_);
+        Resume->Priority_=Handle.promise().Frame_->Priority_;
+        return Antecedent->Queue_->add_resume(Antecedent,Resume);
+    }
+    
+    T await_resume(){return Future_.get();}
+};
+
+///Makes ThreadFutures awaitable in a CoTask, consumes the future
+///@{
+template<typename T>
+FutureAwaiter<T> operator co_await(ThreadFuture<T>&& Future)
+{
+    return FutureAwaiter<T>{std::move(Future)};
+}
+template<typename T>
+FutureAwaiter<T> operator co_await(ThreadFuture<T>& Future)
+{
+    return FutureAwaiter<T>{std::move(Future)};
+}
+///@}
+
+}//End namespace LibTaskForce
+#endif /* __cpp_impl_coroutine */
+#endif /* LIBTASKFORCE_GUARD_COTASK_HPP */
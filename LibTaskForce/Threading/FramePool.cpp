@@ -0,0 +1,176 @@
+/*  
+ *   LibTaskForce: An open-source library for task-based parallelism
+ * 
+ *   Copyright (C) 2016 Ryan M. Richard
+ * 
+ *   This file is part of LibTaskForce.
+ *
+ *   LibTaskForce is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LibTaskForce is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LibTaskForce.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <vector>
+#include "LibTaskForce/Threading/FramePool.hpp"
+
+namespace LibTaskForce{
+
+///The smallest size class is 2^MinShift bytes
+static const size_t MinShift=6;
+
+///The number of size classes, each twice as big as the last
+static const size_t NClasses=5;
+
+///A thread keeps at most this many free blocks of a size class
+static const size_t MaxCached=256;
+
+///Number of blocks in a freshly allocated slab
+static const size_t SlabSize=64;
+
+constexpr size_t FramePool::Alignment;
+
+/** \brief Gets \p Size bytes plus room to align them from ::operator new and
+ *         returns the first aligned address past the start
+ * 
+ *  The gap before the returned address is at least a pointer wide, since
+ *  ::operator new's own alignment is, and the raw address is kept there for
+ *  aligned_delete().
+ */
+static char* aligned_new(size_t Size)
+{
+    char* Raw=static_cast<char*>(::operator new(Size+FramePool::Alignment));
+    char* Block=Raw+FramePool::Alignment-
+                reinterpret_cast<std::uintptr_t>(Raw)%FramePool::Alignment;
+    reinterpret_cast<char**>(Block)[-1]=Raw;
+    return Block;
+}
+
+///Frees a block from aligned_new()
+static void aligned_delete(void* Ptr)
+{
+    ::operator delete(static_cast<char**>(Ptr)[-1]);
+}
+
+///A free block, which we use to link up the free list
+struct FreeBlock{
+    FreeBlock* Next_;
+};
+
+///Returns the size class for \p Size, NClasses if it is too big for any
+inline size_t size_class(size_t Size)
+{
+    size_t Class=0;
+    while(Class<NClasses && (size_t(1)<<(Class+MinShift))<Size)++Class;
+    return Class;
+}
+
+///Where threads put surplus blocks and get more from
+struct Depot{
+    std::mutex Mutex_;///< Guards the members
+    FreeBlock* Free_[NClasses]={};///< Blocks given back by threads
+    
+    ///Takes up to \p n blocks of class \p Class, carving a slab if needed
+    FreeBlock* take(size_t Class,size_t& n)
+    {
+        std::lock_guard<std::mutex> Lock(Mutex_);
+        FreeBlock* Head=Free_[Class];
+        if(Head){
+            FreeBlock* Last=Head;
+            size_t i=1;
+            for(;i<n && Last->Next_;++i)Last=Last->Next_;
+            Free_[Class]=Last->Next_;
+            Last->Next_=nullptr;
+            n=i;
+            return Head;
+        }
+        const size_t BlockSize=size_t(1)<<(Class+MinShift);
+        char* Slab=aligned_new(BlockSize*SlabSize);
+        for(size_t j=0;j<SlabSize;++j)
+            reinterpret_cast<FreeBlock*>(Slab+j*BlockSize)->Next_=
+                (j+1<SlabSize?reinterpret_cast<FreeBlock*>(Slab+(j+1)*BlockSize)
+                              :nullptr);
+        n=SlabSize;
+        return reinterpret_cast<FreeBlock*>(Slab);
+    }
+    
+    ///Gives the blocks in the list [First,Last] back to the depot
+    void give(size_t Class,FreeBlock* First,FreeBlock* Last)
+    {
+        std::lock_guard<std::mutex> Lock(Mutex_);
+        Last->Next_=Free_[Class];
+        Free_[Class]=First;
+    }
+};
+
+///Never destroyed, so threads exiting late can still give blocks back
+static Depot& the_depot()
+{
+    static Depot* TheDepot=new Depot;
+    return *TheDepot;
+}
+
+///A thread's free lists, handed to the depot when the thread exits
+struct Cache{
+    FreeBlock* Free_[NClasses]={};///< Free blocks by size class
+    size_t NFree_[NClasses]={};///< Length of each list
+    
+    ~Cache()
+    {
+        for(size_t i=0;i<NClasses;++i){
+            if(!Free_[i])continue;
+            FreeBlock* Last=Free_[i];
+            while(Last->Next_)Last=Last->Next_;
+            the_depot().give(i,Free_[i],Last);
+        }
+    }
+};
+
+static thread_local Cache MyCache;
+
+void* FramePool::allocate(size_t Size)
+{
+    const size_t Class=size_class(Size);
+    if(Class==NClasses)return aligned_new(Size);
+    if(!MyCache.Free_[Class]){
+        size_t n=MaxCached/2;
+        MyCache.Free_[Class]=the_depot().take(Class,n);
+        MyCache.NFree_[Class]=n;
+    }
+    FreeBlock* Block=MyCache.Free_[Class];
+    MyCache.Free_[Class]=Block->Next_;
+    --MyCache.NFree_[Class];
+    return Block;
+}
+
+void FramePool::deallocate(void* Ptr,size_t Size)
+{
+    const size_t Class=size_class(Size);
+    if(Class==NClasses)return aligned_delete(Ptr);
+    FreeBlock* Block=static_cast<FreeBlock*>(Ptr);
+    Block->Next_=MyCache.Free_[Class];
+    MyCache.Free_[Class]=Block;
+    if(++MyCache.NFree_[Class]<=MaxCached)return;
+    //Keep half, give the rest back
+    FreeBlock* Last=Block;
+    for(size_t i=1;i<MaxCached/2;++i)Last=Last->Next_;
+    FreeBlock* Surplus=Last->Next_;
+    Last->Next_=nullptr;
+    MyCache.NFree_[Class]=MaxCached/2;
+    Last=Surplus;
+    while(Last->Next_)Last=Last->Next_;
+    the_depot().give(Class,Surplus,Last);
+}
+
+}//End namespace
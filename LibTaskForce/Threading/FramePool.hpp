@@ -0,0 +1,66 @@
+/*  
+ *   LibTaskForce: An open-source library for task-based parallelism
+ * 
+ *   Copyright (C) 2016 Ryan M. Richard
+ * 
+ *   This file is part of LibTaskForce.
+ *
+ *   LibTaskForce is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LibTaskForce is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LibTaskForce.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+/** \file FramePool.hpp
+ *  \brief Recycles the memory of task frames so spawning a task is cheap
+ *  \author Ryan M. Richard
+ *  \version 1.0
+ *  \date October 17, 2026
+ */
+
+#ifndef LIBTASKFORCE_GUARD_FRAMEPOOL_HPP
+#define LIBTASKFORCE_GUARD_FRAMEPOOL_HPP
+
+#include <cstddef>
+
+namespace LibTaskForce {
+
+/** \brief A small-object allocator for task frames
+ * 
+ *  Blocks come in a handful of size classes (64 to 1024 bytes).  Freed
+ *  blocks go into a free list owned by the freeing thread and are handed back
+ *  out by the next allocation of that size on that thread, so in steady state
+ *  spawning a task never touches the global heap.  When a thread's free list
+ *  gets long, half of it is moved to a shared depot; threads whose lists run
+ *  dry refill from the depot before carving new blocks out of a fresh slab.
+ *  This keeps producer/consumer patterns (one thread spawns, another runs)
+ *  from growing without bound.
+ * 
+ *  Requests bigger than the largest size class go to ::operator new.  Slabs
+ *  are never returned to the system.
+ * 
+ *  Every block, pooled or not, is aligned to Alignment (a cache line),
+ *  which is more than ::operator new(size_t) promises.  Types aligned beyond
+ *  that must not come from here (see TaskFrameBase).
+ */
+struct FramePool{
+    ///What every block is aligned to
+    static constexpr size_t Alignment=64;
+    
+    ///Returns a block of at least \p Size bytes
+    static void* allocate(size_t Size);
+    
+    ///Returns \p Ptr, which was allocated with \p Size bytes, to the pool
+    static void deallocate(void* Ptr,size_t Size);
+};
+
+}//End namespace LibTaskForce
+#endif /* LIBTASKFORCE_GUARD_FRAMEPOOL_HPP */
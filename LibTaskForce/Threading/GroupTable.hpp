@@ -0,0 +1,183 @@
+/*  
+ *   LibTaskForce: An open-source library for task-based parallelism
+ * 
+ *   Copyright (C) 2016 Ryan M. Richard
+ * 
+ *   This file is part of LibTaskForce.
+ *
+ *   LibTaskForce is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LibTaskForce is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LibTaskForce.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+/** \file GroupTable.hpp
+ *  \brief The hash tables behind ThreadComm::group_reduce
+ *  \author Ryan M. Richard
+ *  \version 1.0
+ *  \date October 17, 2026
+ */
+
+#ifndef LIBTASKFORCE_GUARD_GROUPTABLE_HPP
+#define LIBTASKFORCE_GUARD_GROUPTABLE_HPP
+
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace LibTaskForce {
+
+/** \brief A linear-probing hash table that combines values with equal keys
+ * 
+ *  Unlike std::map or std::unordered_map there is no allocation per entry:
+ *  entries live in one array, which is doubled when it gets 3/4 full.
+ *  Callers pass in the (already well mixed) hash of each key, see
+ *  GroupTable.  A stored hash of 0 marks an empty slot, which is why
+ *  GroupTable sets the top bit of every hash.
+ * 
+ *  Keys and values must be default constructible and movable.
+ */
+template<typename K,typename V>
+class OpenHashTable{
+private:
+    struct Slot{
+        uint64_t Hash_=0;///< 0 if the slot is empty
+        K Key_;
+        V Value_;
+    };
+    std::vector<Slot> Slots_;///< Always empty or a power of 2 long
+    size_t Size_=0;///< Number of full slots
+    unsigned Shift_=64;///< 64-log2(Slots_.size())
+    
+    ///Where the probe for \p Hash starts (Fibonacci hashing on the top bits)
+    size_t home(uint64_t Hash)const
+    {
+        return static_cast<size_t>((Hash*0x9E3779B97F4A7C15ull)>>Shift_);
+    }
+    
+    ///Puts a key known not to be in the table into an empty slot
+    void place(Slot&& NewSlot)
+    {
+        const size_t Mask=Slots_.size()-1;
+        size_t i=home(NewSlot.Hash_);
+        while(Slots_[i].Hash_)i=(i+1)&Mask;
+        Slots_[i]=std::move(NewSlot);
+    }
+    
+    ///Doubles the number of slots (or makes the first 16)
+    void grow()
+    {
+        std::vector<Slot> Old(Slots_.empty()?16:2*Slots_.size());
+        Old.swap(Slots_);
+        Shift_=64;
+        for(size_t n=Slots_.size();n>1;n/=2)--Shift_;
+        for(Slot& S:Old)if(S.Hash_)place(std::move(S));
+    }
+public:
+    size_t size()const{return Size_;}///< Number of distinct keys
+    
+    ///Adds \p Value under \p Key, combining with \p Fxn if the key is there
+    template<typename fxn_type>
+    void add(uint64_t Hash,K&& Key,V&& Value,const fxn_type& Fxn)
+    {
+        if(4*(Size_+1)>3*Slots_.size())grow();
+        const size_t Mask=Slots_.size()-1;
+        for(size_t i=home(Hash);;i=(i+1)&Mask){
+            Slot& S=Slots_[i];
+            if(!S.Hash_){
+                S.Hash_=Hash;
+                S.Key_=std::move(Key);
+                S.Value_=std::move(Value);
+                ++Size_;
+                return;
+            }
+            if(S.Hash_==Hash && S.Key_==Key){
+                S.Value_=Fxn(std::move(S.Value_),std::move(Value));
+                return;
+            }
+        }
+    }
+    
+    /** \brief Adds every entry of \p Other to this table, leaving \p Other
+     *  empty
+     * 
+     *  The smaller table is the one re-inserted, but a shared key is
+     *  always combined as Fxn(this table's value, \p Other's value), so
+     *  \p Fxn need not be commutative.
+     */
+    template<typename fxn_type>
+    void merge(OpenHashTable& Other,const fxn_type& Fxn)
+    {
+        if(Size_<Other.Size_){
+            std::swap(*this,Other);
+            //Other now holds the left-hand operands
+            auto Flipped=[&Fxn](V&& Rhs,V&& Lhs){
+                return Fxn(std::move(Lhs),std::move(Rhs));
+            };
+            for(Slot& S:Other.Slots_)
+                if(S.Hash_)add(S.Hash_,std::move(S.Key_),std::move(S.Value_),Flipped);
+        }
+        else
+            for(Slot& S:Other.Slots_)
+                if(S.Hash_)add(S.Hash_,std::move(S.Key_),std::move(S.Value_),Fxn);
+        Other=OpenHashTable();
+    }
+    
+    ///Moves the entries out to \p Out as std::pair<K,V>s, returns the new end
+    template<typename out_itr>
+    out_itr move_to(out_itr Out)
+    {
+        for(Slot& S:Slots_)
+            if(S.Hash_)*Out++=std::make_pair(std::move(S.Key_),std::move(S.Value_));
+        return Out;
+    }
+};
+
+/** \brief A thread's partial result in ThreadComm::group_reduce
+ * 
+ *  The keys are split into NParts partitions by the low bits of their
+ *  hash, each with its own OpenHashTable.  Every thread uses the same
+ *  split, so at the end partition i of all the threads' tables can be
+ *  merged independently of (and in parallel with) every other partition.
+ */
+template<typename K,typename V>
+class GroupTable{
+private:
+    std::vector<OpenHashTable<K,V>> Parts_;///< One per partition
+    
+    ///The splitmix64 finalizer, std::hash is often the identity for ints
+    static uint64_t mix(uint64_t x)
+    {
+        x=(x^(x>>30))*0xBF58476D1CE4E5B9ull;
+        x=(x^(x>>27))*0x94D049BB133111EBull;
+        return x^(x>>31);
+    }
+public:
+    ///\p NParts must be a power of 2
+    GroupTable(size_t NParts=1):Parts_(NParts){}
+    
+    size_t nparts()const{return Parts_.size();}
+    OpenHashTable<K,V>& part(size_t i){return Parts_[i];}
+    
+    ///Adds \p Value under \p Key, combining with \p Fxn if the key is there
+    template<typename fxn_type>
+    void add(K&& Key,V&& Value,const fxn_type& Fxn)
+    {
+        //The top bit marks a full slot, so is always set
+        const uint64_t Hash=mix(std::hash<K>()(Key))|(1ull<<63);
+        Parts_[static_cast<size_t>(Hash)&(Parts_.size()-1)].add(
+            Hash,std::move(Key),std::move(Value),Fxn);
+    }
+};
+
+}//End namespace LibTaskForce
+#endif /* LIBTASKFORCE_GUARD_GROUPTABLE_HPP */
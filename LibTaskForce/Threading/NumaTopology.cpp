@@ -0,0 +1,155 @@
+/*  
+ *   LibTaskForce: An open-source library for task-based parallelism
+ * 
+ *   Copyright (C) 2016 Ryan M. Richard
+ * 
+ *   This file is part of LibTaskForce.
+ *
+ *   LibTaskForce is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LibTaskForce is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LibTaskForce.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include "LibTaskForce/Threading/NumaTopology.hpp"
+
+namespace LibTaskForce{
+
+///Where Linux describes the NUMA nodes
+static const char* NodeDir="/sys/devices/system/node/";
+
+///Reads the first line of file \p Name, empty if it can't be read
+static std::string read_line(const std::string& Name)
+{
+    std::ifstream File(Name);
+    std::string Line;
+    std::getline(File,Line);
+    return Line;
+}
+
+///The CPUs the process may run on, sorted
+static std::vector<size_t> allowed_cpus()
+{
+    std::vector<size_t> Cpus;
+#ifdef __linux__
+    cpu_set_t Mask;
+    CPU_ZERO(&Mask);
+    if(!sched_getaffinity(0,sizeof(Mask),&Mask))
+        for(size_t Cpu=0;Cpu<CPU_SETSIZE;++Cpu)
+            if(CPU_ISSET(Cpu,&Mask))Cpus.push_back(Cpu);
+#endif
+    if(Cpus.empty())
+        for(size_t Cpu=0;Cpu<std::max(1u,std::thread::hardware_concurrency());++Cpu)
+            Cpus.push_back(Cpu);
+    return Cpus;
+}
+
+std::vector<size_t> NumaTopology::parse_list(const std::string& List)
+{
+    std::vector<size_t> Ids;
+    std::stringstream ss(List);
+    std::string Range;
+    while(std::getline(ss,Range,',')){
+        size_t First,Last;
+        char Dash;
+        std::stringstream RangeStream(Range);
+        if(!(RangeStream>>First))return std::vector<size_t>();
+        Last=First;
+        if(RangeStream>>Dash && (Dash!='-' || !(RangeStream>>Last) || Last<First))
+            return std::vector<size_t>();
+        for(size_t Id=First;Id<=Last;++Id)Ids.push_back(Id);
+    }
+    return Ids;
+}
+
+NumaTopology::NumaTopology()
+{
+    const std::vector<size_t> Allowed=allowed_cpus();
+    const std::string NodeDirName(NodeDir);
+    for(size_t OSNode:parse_list(read_line(NodeDirName+"online"))){
+        std::vector<size_t> Cpus;
+        for(size_t Cpu:parse_list(read_line(NodeDirName+"node"+
+                                  std::to_string(OSNode)+"/cpulist")))
+            if(std::binary_search(Allowed.begin(),Allowed.end(),Cpu))
+                Cpus.push_back(Cpu);
+        if(!Cpus.empty())Nodes_.push_back(std::move(Cpus));
+    }
+    //No sysfs, or it doesn't account for all our CPUs: one node
+    if(ncpus()!=Allowed.size())Nodes_.assign(1,Allowed);
+    for(size_t i=0;Spread_.size()<Allowed.size();++i)
+        for(const std::vector<size_t>& Node:Nodes_)
+            if(i<Node.size())Spread_.push_back(Node[i]);
+}
+
+size_t NumaTopology::ncpus()const
+{
+    size_t NCpus=0;
+    for(const std::vector<size_t>& Node:Nodes_)NCpus+=Node.size();
+    return NCpus;
+}
+
+size_t NumaTopology::node_of(size_t Cpu)const
+{
+    for(size_t Node=0;Node<Nodes_.size();++Node)
+        if(std::find(Nodes_[Node].begin(),Nodes_[Node].end(),Cpu)!=
+           Nodes_[Node].end())return Node;
+    return AnyNode;
+}
+
+size_t NumaTopology::current_node()const
+{
+    if(Nodes_.size()==1)return 0;
+#ifdef __linux__
+    const int Cpu=sched_getcpu();
+    if(Cpu>=0)return node_of(static_cast<size_t>(Cpu));
+#endif
+    return AnyNode;
+}
+
+size_t NumaTopology::spread_cpu(size_t i)const
+{
+    return Spread_[i%Spread_.size()];
+}
+
+bool NumaTopology::pin_thread(size_t Cpu)
+{
+#ifdef __linux__
+    if(Cpu>=CPU_SETSIZE)return false;
+    cpu_set_t Mask;
+    CPU_ZERO(&Mask);
+    CPU_SET(Cpu,&Mask);
+    return !pthread_setaffinity_np(pthread_self(),sizeof(Mask),&Mask);
+#else
+    return false;
+#endif
+}
+
+std::string NumaTopology::print()const
+{
+    std::stringstream ss;
+    ss<<ncpus()<<" CPUs in "<<size()<<" NUMA node(s)"<<std::endl;
+    for(size_t Node=0;Node<Nodes_.size();++Node){
+        ss<<"  Node "<<Node<<":";
+        for(size_t Cpu:Nodes_[Node])ss<<" "<<Cpu;
+        ss<<std::endl;
+    }
+    return ss.str();
+}
+
+}//End namespace
@@ -0,0 +1,91 @@
+/*  
+ *   LibTaskForce: An open-source library for task-based parallelism
+ * 
+ *   Copyright (C) 2016 Ryan M. Richard
+ * 
+ *   This file is part of LibTaskForce.
+ *
+ *   LibTaskForce is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LibTaskForce is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LibTaskForce.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+/** \file NumaTopology.hpp
+ *  \brief Which CPUs we may run on and which NUMA node each belongs to
+ *  \author Ryan M. Richard
+ *  \version 1.0
+ *  \date October 17, 2026
+ */
+
+#ifndef LIBTASKFORCE_GUARD_NUMATOPOLOGY_HPP
+#define LIBTASKFORCE_GUARD_NUMATOPOLOGY_HPP
+
+#include <string>
+#include <vector>
+
+namespace LibTaskForce {
+
+///Preferred node of a task that may run anywhere
+static const size_t AnyNode=static_cast<size_t>(-1);
+
+/** \brief The NUMA nodes of the machine, restricted to the CPUs this process
+ *         may run on
+ * 
+ *  On Linux the nodes are read from sysfs and intersected with the process's
+ *  affinity mask; nodes left without CPUs are dropped.  Elsewhere, or if
+ *  sysfs is not available, all CPUs are put in one node.  Nodes are numbered
+ *  0 to size()-1 in the order of their OS ids.
+ */
+class NumaTopology{
+public:
+    ///Reads the topology of the machine we are running on
+    NumaTopology();
+    
+    size_t size()const{return Nodes_.size();}///< The number of nodes
+    size_t ncpus()const;///< The number of CPUs over all nodes
+    
+    ///The CPUs (OS ids) of node \p Node
+    const std::vector<size_t>& cpus(size_t Node)const{return Nodes_[Node];}
+    
+    ///The node \p Cpu is in, AnyNode if it is not one of ours
+    size_t node_of(size_t Cpu)const;
+    
+    ///The node the calling thread is running on right now, AnyNode if unknown
+    size_t current_node()const;
+    
+    /** \brief The CPU the \p i-th of a set of threads should be pinned to
+     * 
+     *  Consecutive threads go to different nodes (round-robin), so that a
+     *  pool smaller than the machine still gets the memory bandwidth of all
+     *  of its nodes.  Wraps around if there are more threads than CPUs.
+     */
+    size_t spread_cpu(size_t i)const;
+    
+    ///Describes the nodes and their CPUs
+    std::string print()const;
+    
+    /** \brief Parses a Linux CPU (or node) list, e.g. "0-3,8,10-11"
+     * 
+     *  \return The listed ids, in the order given; empty if malformed
+     */
+    static std::vector<size_t> parse_list(const std::string& List);
+    
+    ///Pins the calling thread to \p Cpu, returns false if it could not
+    static bool pin_thread(size_t Cpu);
+    
+private:
+    std::vector<std::vector<size_t>> Nodes_;///< The CPUs of each node
+    std::vector<size_t> Spread_;///< CPUs in the order spread_cpu() uses
+};
+
+}//End namespace LibTaskForce
+#endif /* LIBTASKFORCE_GUARD_NUMATOPOLOGY_HPP */
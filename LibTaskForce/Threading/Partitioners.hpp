@@ -0,0 +1,74 @@
+/*  
+ *   LibTaskForce: An open-source library for task-based parallelism
+ * 
+ *   Copyright (C) 2016 Ryan M. Richard
+ * 
+ *   This file is part of LibTaskForce.
+ *
+ *   LibTaskForce is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LibTaskForce is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LibTaskForce.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+/** \file Partitioners.hpp
+ *  \brief Options for how loops are divided among threads
+ *  \author Ryan M. Richard
+ *  \version 1.0
+ *  \date October 17, 2026
+ */
+
+#ifndef LIBTASKFORCE_GUARD_PARTITIONERS_HPP
+#define LIBTASKFORCE_GUARD_PARTITIONERS_HPP
+
+#include "LibTaskForce/Util/pragma.h"
+
+PRAGMA_WARNING_PUSH
+PRAGMA_WARNING_IGNORE_CONVERT
+PRAGMA_WARNING_IGNORE_FP_EQUALITY
+#include <tbb/tbb.h>
+PRAGMA_WARNING_POP
+
+namespace LibTaskForce {
+class ThreadQueue;
+
+///How ThreadComm::parallel_for divides a range into chunks
+enum Partitioners{
+    SIMPLE_PARTITIONER,///< Splits down to the grain size, no more no less
+    AUTO_PARTITIONER,///< Splits only as much as is needed to balance the load
+    AFFINITY_PARTITIONER///< Like auto, but replays the last sweep's mapping
+};
+
+/** \brief Remembers which thread ran which chunk of a loop
+ * 
+ *  Passing the same LoopAffinity to repeated parallel_for calls over the
+ *  same range makes each thread get the chunks it had last time, so the
+ *  data it touches is likely still in its cache.  Use one per loop (or at
+ *  least per range); the mapping from one loop is of no use to another.
+ * 
+ *  \code
+ *  LoopAffinity Affinity;
+ *  for(size_t Iter=0;Iter<NIters;++Iter)
+ *      Comm.parallel_for(0,N,Sweep,Affinity);
+ *  \endcode
+ */
+class LoopAffinity{
+private:
+    friend ThreadQueue;
+    tbb::affinity_partitioner Partitioner_;///< What actually remembers
+public:
+    LoopAffinity()=default;
+    LoopAffinity(const LoopAffinity&)=delete;
+    LoopAffinity& operator=(const LoopAffinity&)=delete;
+};
+
+}//End namespace LibTaskForce
+#endif /* LIBTASKFORCE_GUARD_PARTITIONERS_HPP */
@@ -0,0 +1,181 @@
+/*  
+ *   LibTaskForce: An open-source library for task-based parallelism
+ * 
+ *   Copyright (C) 2016 Ryan M. Richard
+ * 
+ *   This file is part of LibTaskForce.
+ *
+ *   LibTaskForce is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LibTaskForce is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LibTaskForce.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+/** \file ReduceKernels.hpp
+ *  \brief Chunk kernels for ThreadComm::chunk_reduce on arithmetic types
+ *  \author Ryan M. Richard
+ *  \version 1.0
+ *  \date October 17, 2026
+ */
+
+#ifndef LIBTASKFORCE_GUARD_REDUCEKERNELS_HPP
+#define LIBTASKFORCE_GUARD_REDUCEKERNELS_HPP
+
+#include <cstddef>
+#include <type_traits>
+#include "LibTaskForce/Util/pragma.h"
+
+namespace LibTaskForce {
+
+/** \brief Loops the kernels below are built from
+ * 
+ *  Each loop keeps NLanes independent partial results and only combines
+ *  them at the end.  Without that the compiler may not reorder the
+ *  operations (for floating point types the result would change), so every
+ *  iteration waits on the previous one and nothing gets vectorized.  With
+ *  it the inner loop maps onto vector registers at -O2 without any
+ *  -ffast-math style flags.
+ * 
+ *  All of them require a contiguous, non-empty range.
+ */
+struct SIMDLoops{
+    ///Partial results kept per loop, enough to fill two AVX registers
+    ///(PRAGMA_UNROLL_8 has to match)
+    static const size_t NLanes=8;
+    
+    ///Sum of X[0,N)
+    template<typename T>
+    static T sum(const T* X,size_t N)
+    {
+        T Acc[NLanes]={};
+        size_t i=0;
+        for(;i+NLanes<=N;i+=NLanes)
+            PRAGMA_UNROLL_8
+            for(size_t j=0;j<NLanes;++j)Acc[j]+=X[i+j];
+        T Result=T();
+        for(size_t j=0;j<NLanes;++j)Result+=Acc[j];
+        for(;i<N;++i)Result+=X[i];
+        return Result;
+    }
+    
+    ///Sum of X[i]*Y[i] for i in [0,N)
+    template<typename T>
+    static T dot(const T* X,const T* Y,size_t N)
+    {
+        T Acc[NLanes]={};
+        size_t i=0;
+        for(;i+NLanes<=N;i+=NLanes)
+            PRAGMA_UNROLL_8
+            for(size_t j=0;j<NLanes;++j)Acc[j]+=X[i+j]*Y[i+j];
+        T Result=T();
+        for(size_t j=0;j<NLanes;++j)Result+=Acc[j];
+        for(;i<N;++i)Result+=X[i]*Y[i];
+        return Result;
+    }
+    
+    ///The element of X[0,N) that \p Before orders first
+    template<typename T,typename Compare>
+    static T extreme(const T* X,size_t N,Compare Before)
+    {
+        T Acc[NLanes];
+        for(size_t j=0;j<NLanes;++j)Acc[j]=X[0];
+        size_t i=0;
+        for(;i+NLanes<=N;i+=NLanes)
+            PRAGMA_UNROLL_8
+            for(size_t j=0;j<NLanes;++j)
+                Acc[j]=Before(X[i+j],Acc[j])?X[i+j]:Acc[j];
+        T Result=X[0];
+        for(size_t j=0;j<NLanes;++j)Result=Before(Acc[j],Result)?Acc[j]:Result;
+        for(;i<N;++i)Result=Before(X[i],Result)?X[i]:Result;
+        return Result;
+    }
+    
+    ///Orders smaller values first, for extreme()
+    struct Less{
+        template<typename T>
+        bool operator()(const T& LHS,const T& RHS)const{return LHS<RHS;}
+    };
+    
+    ///Orders larger values first, for extreme()
+    struct Greater{
+        template<typename T>
+        bool operator()(const T& LHS,const T& RHS)const{return RHS<LHS;}
+    };
+};
+
+/** \brief The kernels
+ * 
+ *  Each satisfies the interface chunk_reduce() expects: a chunk call taking
+ *  two iterators into contiguous memory (e.g. pointers or
+ *  std::vector<T>::iterator) and a combine call taking two partial results.
+ * 
+ *  \code
+ *  double Sum=Comm.chunk_reduce<double>(SumKernel<double>(),X.begin(),X.end());
+ *  double XY=Comm.chunk_reduce<double>(DotKernel<double>(X.data(),Y.data()),
+ *                                      X.begin(),X.end());
+ *  \endcode
+ */
+///@{
+template<typename T>
+struct SumKernel{
+    static_assert(std::is_arithmetic<T>::value,"SumKernel needs arithmetic T");
+    template<typename itr_type>
+    T operator()(itr_type Begin,itr_type End)const
+    {
+        return SIMDLoops::sum<T>(&*Begin,static_cast<size_t>(End-Begin));
+    }
+    T operator()(T LHS,T RHS)const{return LHS+RHS;}
+};
+
+template<typename T>
+struct MinKernel{
+    static_assert(std::is_arithmetic<T>::value,"MinKernel needs arithmetic T");
+    template<typename itr_type>
+    T operator()(itr_type Begin,itr_type End)const
+    {
+        return SIMDLoops::extreme<T>(&*Begin,static_cast<size_t>(End-Begin),
+                                     SIMDLoops::Less());
+    }
+    T operator()(T LHS,T RHS)const{return RHS<LHS?RHS:LHS;}
+};
+
+template<typename T>
+struct MaxKernel{
+    static_assert(std::is_arithmetic<T>::value,"MaxKernel needs arithmetic T");
+    template<typename itr_type>
+    T operator()(itr_type Begin,itr_type End)const
+    {
+        return SIMDLoops::extreme<T>(&*Begin,static_cast<size_t>(End-Begin),
+                                     SIMDLoops::Greater());
+    }
+    T operator()(T LHS,T RHS)const{return LHS<RHS?RHS:LHS;}
+};
+
+///Dot product of the range being reduced (which must start at \p X) and \p Y
+template<typename T>
+struct DotKernel{
+    static_assert(std::is_arithmetic<T>::value,"DotKernel needs arithmetic T");
+    const T* X_;///< Start of the range being reduced
+    const T* Y_;///< Start of the other vector
+    DotKernel(const T* X,const T* Y):X_(X),Y_(Y){}
+    template<typename itr_type>
+    T operator()(itr_type Begin,itr_type End)const
+    {
+        const T* XBegin=&*Begin;
+        return SIMDLoops::dot<T>(XBegin,Y_+(XBegin-X_),
+                                 static_cast<size_t>(End-Begin));
+    }
+    T operator()(T LHS,T RHS)const{return LHS+RHS;}
+};
+///@}
+
+}//End namespace LibTaskForce
+#endif /* LIBTASKFORCE_GUARD_REDUCEKERNELS_HPP */
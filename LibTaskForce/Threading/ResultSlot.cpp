@@ -0,0 +1,65 @@
+/*  
+ *   LibTaskForce: An open-source library for task-based parallelism
+ * 
+ *   Copyright (C) 2016 Ryan M. Richard
+ * 
+ *   This file is part of LibTaskForce.
+ *
+ *   LibTaskForce is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LibTaskForce is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LibTaskForce.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include "LibTaskForce/Threading/ResultSlot.hpp"
+
+namespace LibTaskForce{
+
+///Where parked threads sleep
+struct Bucket{
+    std::mutex Mutex_;
+    std::condition_variable Wake_;
+};
+
+///Number of buckets (power of 2)
+static const size_t NBuckets=64;
+
+static Bucket& bucket(const void* Address)
+{
+    static Bucket Buckets[NBuckets];
+    const std::uintptr_t i=reinterpret_cast<std::uintptr_t>(Address);
+    return Buckets[((i>>4)^(i>>10))&(NBuckets-1)];
+}
+
+bool park(std::atomic<int>& State,int Mask,int WaiterBit,
+          std::chrono::microseconds Timeout)
+{
+    //Pairs with the producer's fetch_or of the value bit: one of us sees
+    //the other's bit
+    if(State.fetch_or(WaiterBit,std::memory_order_acq_rel)&Mask)return true;
+    Bucket& B=bucket(&State);
+    std::unique_lock<std::mutex> Lock(B.Mutex_);
+    return B.Wake_.wait_for(Lock,Timeout,[&](){
+        return (State.load(std::memory_order_acquire)&Mask)!=0;
+    });
+}
+
+void unpark(const std::atomic<int>& State)
+{
+    Bucket& B=bucket(&State);
+    std::lock_guard<std::mutex> Lock(B.Mutex_);
+    B.Wake_.notify_all();
+}
+
+}//End namespace
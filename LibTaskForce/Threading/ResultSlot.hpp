@@ -0,0 +1,166 @@
+/*  
+ *   LibTaskForce: An open-source library for task-based parallelism
+ * 
+ *   Copyright (C) 2016 Ryan M. Richard
+ * 
+ *   This file is part of LibTaskForce.
+ *
+ *   LibTaskForce is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LibTaskForce is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LibTaskForce.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+/** \file ResultSlot.hpp
+ *  \brief A lightweight single-producer/single-consumer promise/future
+ *  \author Ryan M. Richard
+ *  \version 1.0
+ *  \date October 17, 2026
+ */
+
+#ifndef LIBTASKFORCE_GUARD_RESULTSLOT_HPP
+#define LIBTASKFORCE_GUARD_RESULTSLOT_HPP
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace LibTaskForce {
+
+/** \brief Parks the calling thread until \p State has a bit of \p Mask set,
+ *         or \p Timeout passes
+ * 
+ *  Rather than give every slot its own mutex and condition variable, waiters
+ *  sleep on one of a fixed number of buckets picked by hashing the address
+ *  of \p State.  Before parking, the waiter sets \p WaiterBit in \p State so
+ *  that the producer knows to call unpark().
+ * 
+ *  \return True if a bit of \p Mask was set
+ */
+bool park(std::atomic<int>& State,int Mask,int WaiterBit,
+          std::chrono::microseconds Timeout);
+
+///Wakes the threads parked on \p State
+void unpark(const std::atomic<int>& State);
+
+/** \brief Where a task's result goes
+ * 
+ *  This replaces the std::promise/std::future pair, which costs a mutex, a
+ *  condition variable, and a heap allocated shared state per task.  A slot
+ *  has exactly one producer (the task) and one consumer (its future), and
+ *  lives inside the task's frame.  It is an atomic state word plus inline
+ *  storage for the value (or exception).
+ * 
+ *  Readiness is published with a release operation and observed with an
+ *  acquire one.  Consumers that have to block park (see park()), and the
+ *  producer only pays for a wake-up if someone actually parked.
+ */
+template<typename T>
+class ResultSlot{
+private:
+    ///Bits of State_
+    enum States{
+        HAS_VALUE=1,
+        HAS_ERROR=2,
+        HAS_WAITER=4
+    };
+    
+    std::atomic<int> State_;///< Bitwise or of States
+    typename std::aligned_storage<sizeof(T),alignof(T)>::type Value_;
+    std::exception_ptr Error_;///< The exception if the task threw
+    
+    T* ptr(){return reinterpret_cast<T*>(&Value_);}
+    
+    ///Makes the result visible to the consumer
+    void publish(int Bit)
+    {
+        if(State_.fetch_or(Bit,std::memory_order_acq_rel)&HAS_WAITER)
+            unpark(State_);
+    }
+public:
+    ResultSlot():State_(0){}
+    
+    ///Slots are referred to by address, so they don't copy or move
+    ///@{
+    ResultSlot(const ResultSlot&)=delete;
+    ResultSlot& operator=(const ResultSlot&)=delete;
+    ///@}
+    
+    ~ResultSlot()
+    {
+        if(State_.load(std::memory_order_relaxed)&HAS_VALUE)ptr()->~T();
+    }
+    
+    ///Empties the slot so it can take another result, only valid when no
+    ///one is using it
+    void reset()
+    {
+        if(State_.load(std::memory_order_relaxed)&HAS_VALUE)ptr()->~T();
+        Error_=nullptr;
+        State_.store(0,std::memory_order_relaxed);
+    }
+    
+    ///Stores the result, may be called once (and only if no exception is set)
+    template<typename U>
+    void set_value(U&& Value)
+    {
+        new(&Value_) T(std::forward<U>(Value));
+        publish(HAS_VALUE);
+    }
+    
+    ///Stores an exception, which get() will rethrow
+    void set_exception(std::exception_ptr Error)
+    {
+        Error_=Error;
+        publish(HAS_ERROR);
+    }
+    
+    ///True if a value or an exception has been set
+    bool ready()const
+    {
+        return State_.load(std::memory_order_acquire)&(HAS_VALUE|HAS_ERROR);
+    }
+    
+    ///Blocks for at most \p Timeout, returns true if the result is ready
+    template<typename Rep,typename Period>
+    bool wait_for(const std::chrono::duration<Rep,Period>& Timeout)
+    {
+        return ready() || park(State_,HAS_VALUE|HAS_ERROR,HAS_WAITER,
+            std::chrono::duration_cast<std::chrono::microseconds>(Timeout));
+    }
+    
+    ///Rethrows the task's exception if it had one
+    void check()const
+    {
+        if(State_.load(std::memory_order_acquire)&HAS_ERROR)
+            std::rethrow_exception(Error_);
+    }
+    
+    ///Moves the value out, only valid once ready()
+    T get()
+    {
+        check();
+        return std::move(*ptr());
+    }
+    
+    ///The value, left in place, only valid once ready()
+    const T& value()
+    {
+        check();
+        return *ptr();
+    }
+};
+
+}//End namespace LibTaskForce
+#endif /* LIBTASKFORCE_GUARD_RESULTSLOT_HPP */
@@ -0,0 +1,246 @@
+/*  
+ *   LibTaskForce: An open-source library for task-based parallelism
+ * 
+ *   Copyright (C) 2016 Ryan M. Richard
+ * 
+ *   This file is part of LibTaskForce.
+ *
+ *   LibTaskForce is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LibTaskForce is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LibTaskForce.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+/** \file TaskGraph.hpp
+ *  \brief Tasks with explicitly declared dependencies
+ *  \author Ryan M. Richard
+ *  \version 1.0
+ *  \date October 17, 2026
+ */
+
+#ifndef LIBTASKFORCE_GUARD_TASKGRAPH_HPP
+#define LIBTASKFORCE_GUARD_TASKGRAPH_HPP
+
+#include <atomic>
+#include <initializer_list>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "LibTaskForce/General/GraphNode.hpp"
+#include "LibTaskForce/Threading/ThreadComm.hpp"
+#include "LibTaskForce/Threading/ThreadQueue.hpp"
+#include "LibTaskForce/Threading/ThreadTask.hpp"
+#include "LibTaskForce/Util/ParallelAssert.hpp"
+
+namespace LibTaskForce {
+class TaskGraph;
+
+/** \brief The frame of a TaskGraph node
+ * 
+ *  Node frames start out held, like continuations.  When a node is done,
+ *  successfully or not, it tells the graph, which releases the successors
+ *  whose last predecessor it was.
+ */
+template<typename TaskType>
+struct GraphFrame:public TaskFrame<TaskType>{
+    TaskGraph* Graph_;///< The graph we are a node of
+    size_t Index_;///< Which node we are
+    
+    GraphFrame(TaskType&& Task,ThreadQueue* Queue,TaskGraph* Graph,
+               size_t Index):
+        TaskFrame<TaskType>(std::move(Task),Queue,true),Graph_(Graph),
+        Index_(Index)
+    {}
+    
+    inline void compute();
+    inline void abandon();
+};
+
+/** \brief A set of tasks and the dependencies among them
+ * 
+ *  Calling get() on one future from inside another task (as FibTask does)
+ *  expresses a dependency, but at the price of a thread waiting on it.  A
+ *  TaskGraph instead knows each node's predecessors up front: a node is
+ *  handed to the comm's scheduler the moment its last predecessor finishes,
+ *  and until then nothing waits on it.
+ * 
+ *  Nodes are functors like those given to ThreadComm::add_task and they get
+ *  the graph's comm.  They read their predecessors' results with value().
+ *  \code
+ *  TaskGraph Graph(Comm);
+ *  GraphNode<double> A=Graph.add_node<double>(MakeA());
+ *  GraphNode<double> B=Graph.add_node<double>(MakeB());
+ *  GraphNode<double> C=Graph.add_node<double>([&](ThreadComm&){
+ *      return Graph.value(A)+Graph.value(B);
+ *  },{A,B});
+ *  Graph.run();
+ *  double Sum=Graph.value(C);//Waits for C
+ *  \endcode
+ * 
+ *  The graph must be acyclic.  A node whose predecessor threw still runs,
+ *  and the exception is rethrown if it calls value() on that predecessor.
+ *  If the comm is cancelled the remaining nodes are dropped (their value()
+ *  throws TaskCancelled).  The graph must outlive its run, the destructor
+ *  waits for it.
+ * 
+ *  A graph is recorded once and can be run many times, e.g. once per
+ *  iteration of a solver whose task structure doesn't change.  The frames,
+ *  counters and edges are all made while recording, so a replay only resets
+ *  them and hands the roots to the scheduler.  Each run() discards the
+ *  previous run's values.
+ */
+class TaskGraph{
+private:
+    template<typename> friend struct GraphFrame;
+    using frame_ptr=std::unique_ptr<TaskFrameBase,FrameReleaser>;
+    
+    ThreadComm* Comm_;///< Where our nodes run
+    ThreadQueue* Queue_;///< Comm_'s queue
+    std::vector<frame_ptr> Frames_;///< The nodes
+    std::vector<std::vector<size_t>> Succs_;///< Who depends on each node
+    std::vector<size_t> NPreds_;///< How many nodes each node depends on
+    ///Predecessors of each node that haven't finished, during run()
+    std::unique_ptr<std::atomic<size_t>[]> NWaiting_;
+    std::vector<size_t> Roots_;///< The nodes without predecessors
+    std::atomic<size_t> NDone_;///< Nodes finished during run()
+    bool Ran_;///< True once run() was called
+    
+    ///Called by node \p i when it is done, releases its ready successors
+    void finished(size_t i)
+    {
+        for(size_t Succ:Succs_[i])
+            if(!--NWaiting_[Succ])Queue_->release_held(Frames_[Succ].get());
+        ++NDone_;
+    }
+    
+    ///Runs other tasks until \p Done returns true
+    template<typename fxn_type>
+    void help_until(const fxn_type& Done)const
+    {
+        while(!Done())
+            if(!Queue_->help())std::this_thread::yield();
+    }
+public:
+    ///Makes an empty graph whose nodes will run on \p Comm
+    explicit TaskGraph(ThreadComm& Comm):
+        Comm_(&Comm),Queue_(Comm.Queue_.get()),NDone_(0),Ran_(false)
+    {}
+    
+    ///Waits for the graph, if it was run
+    ~TaskGraph(){if(Ran_)wait();}
+    
+    ///Graphs are referred to by their nodes, so they can't be copied or moved
+    ///@{
+    TaskGraph(const TaskGraph&)=delete;
+    TaskGraph& operator=(const TaskGraph&)=delete;
+    ///@}
+    
+    size_t size()const{return Frames_.size();}///< The number of nodes
+    
+    /** \brief Adds a node that runs \p Fxn after the nodes in \p After
+     * 
+     *  \param[in] Fxn A functor with the signature of those given to
+     *                 ThreadComm::add_task
+     *  \param[in] After Nodes that must finish before this one starts
+     *  \return A handle to the new node
+     */
+    template<typename return_type,typename functor_type>
+    GraphNode<return_type> add_node(functor_type&& Fxn,
+                                    std::initializer_list<GraphNodeBase> After={})
+    {
+        PARALLEL_ASSERT(!Ran_,"Nodes can't be added once the graph ran");
+        using fxn_type=typename std::decay<functor_type>::type;
+        using task_type=ThreadTask<return_type,fxn_type,ThreadComm>;
+        GraphNode<return_type> Node;
+        Node.Index_=Frames_.size();
+        Frames_.emplace_back(new GraphFrame<task_type>(
+            task_type(fxn_type(std::forward<functor_type>(Fxn)),*Comm_),
+            Queue_,this,Node.Index_));
+        Succs_.emplace_back();
+        NPreds_.push_back(0);
+        for(const GraphNodeBase& Pred:After)add_edge(Pred,Node);
+        return Node;
+    }
+    
+    ///Makes \p To wait for \p From
+    void add_edge(const GraphNodeBase& From,const GraphNodeBase& To)
+    {
+        PARALLEL_ASSERT(!Ran_,"Edges can't be added once the graph ran");
+        PARALLEL_ASSERT(From.Index_<size() && To.Index_<size(),
+                        "Both ends of an edge must be nodes of this graph");
+        Succs_[From.Index_].push_back(To.Index_);
+        ++NPreds_[To.Index_];
+    }
+    
+    /** \brief Hands the nodes without predecessors to the scheduler, doesn't
+     *         wait
+     * 
+     *  If the graph already ran, waits for that run and resets the nodes
+     *  first.
+     */
+    void run()
+    {
+        if(!Ran_){
+            NWaiting_.reset(new std::atomic<size_t>[size()]);
+            for(size_t i=0;i<size();++i)if(!NPreds_[i])Roots_.push_back(i);
+        }
+        else{
+            wait();
+            for(frame_ptr& Frame:Frames_){
+                //The scheduler may not have let go of the frame just yet
+                while(Frame->NRefs_.load(std::memory_order_acquire)!=1)
+                    std::this_thread::yield();
+                Frame->rearm();
+            }
+        }
+        Ran_=true;
+        NDone_.store(0);
+        for(size_t i=0;i<size();++i)
+            NWaiting_[i].store(NPreds_[i],std::memory_order_relaxed);
+        for(size_t Root:Roots_)Queue_->release_held(Frames_[Root].get());
+    }
+    
+    ///Waits for every node, running other tasks in the meantime
+    void wait()const
+    {
+        PARALLEL_ASSERT(Ran_,"The graph must be run before it can be waited on");
+        help_until([this](){return NDone_.load()==size();});
+    }
+    
+    ///The result of \p Node, waits for it if need be
+    template<typename T>
+    const T& value(const GraphNode<T>& Node)const
+    {
+        PARALLEL_ASSERT(Ran_,"The graph must be run before it has values");
+        ResultSlot<T>& Result=
+            static_cast<ResultFrame<T>*>(Frames_[Node.Index_].get())->Result_;
+        help_until([&Result](){return Result.ready();});
+        return Result.value();
+    }
+};
+
+template<typename TaskType>
+void GraphFrame<TaskType>::compute()
+{
+    TaskFrame<TaskType>::compute();
+    Graph_->finished(Index_);
+}
+
+template<typename TaskType>
+void GraphFrame<TaskType>::abandon()
+{
+    TaskFrame<TaskType>::abandon();
+    Graph_->finished(Index_);
+}
+
+}//End namespace LibTaskForce
+#endif /* LIBTASKFORCE_GUARD_TASKGRAPH_HPP */
@@ -26,23 +26,48 @@
 namespace LibTaskForce{
 
 ThreadComm::ThreadComm(ThreadEnv* Env):
-    base_type(Env,new ThreadQueue(Env->size()))
+    base_type(Env,new ThreadQueue(Env->size(),Env->Pool_.get()))
+{
+}
+
+ThreadComm::ThreadComm(ThreadEnv* Env,size_t NThreads,arena_ptr Arena,
+                       const CancelToken& Token):
+    base_type(Env,new ThreadQueue(NThreads,Env->Pool_.get(),Arena.get(),Token)),
+    Arena_(Arena)
 {
 }
 
 ThreadComm::~ThreadComm()
 {
+    //Tasks still being drained may add tasks through us, so Queue_ must stay
+    //set until they are done; only then can it (and Arena_) go
+    if(Queue_)Queue_->wait();
     if(Registered_)Env_->release_comm(*this);
+    Queue_.reset();
 }
 
 size_t ThreadComm::size()const
 {
-    return Env_->size();
+    return Queue_->size();
+}
+
+void ThreadComm::cancel()
+{
+    Queue_->cancel();
+}
+
+bool ThreadComm::cancelled()const
+{
+    return Queue_->cancelled();
 }
 
-std::unique_ptr<ThreadComm> ThreadComm::split(size_t)const{
-    
-    std::unique_ptr<ThreadComm> NewComm(new ThreadComm(Env_));
+std::unique_ptr<ThreadComm> ThreadComm::split(size_t n)const{
+    if(!n||n>=size())
+        return std::unique_ptr<ThreadComm>(
+            new ThreadComm(Env_,size(),Arena_,Queue_->token().child()));
+    arena_ptr Arena=std::make_shared<tbb::task_arena>((int)n);
+    std::unique_ptr<ThreadComm> NewComm(
+        new ThreadComm(Env_,n,Arena,Queue_->token().child()));
     //Env_->register_comm(NewComm.get());
     //NewComm->Registered_=true;
     return NewComm;
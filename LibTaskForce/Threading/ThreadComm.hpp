@@ -29,10 +29,14 @@
 #ifndef LIBTASKFORCE_GUARD_THREADCOMM_HPP
 #define LIBTASKFORCE_GUARD_THREADCOMM_HPP
 
+#include <iterator>
 #include <memory>
+#include "LibTaskForce/Threading/CoTask.hpp"
 #include "LibTaskForce/Threading/ThreadFuture.hpp"
 #include "LibTaskForce/Threading/ThreadQueue.hpp"
+#include "LibTaskForce/Threading/ThreadScratch.hpp"
 #include "LibTaskForce/Threading/ThreadTask.hpp"
+#include "LibTaskForce/Threading/ReduceKernels.hpp"
 #include "LibTaskForce/General/GeneralComm.hpp"
 
 namespace LibTaskForce {
@@ -48,8 +52,17 @@ class ThreadQueue;
 class ThreadComm:public GeneralComm<ThreadEnv,ThreadQueue>{
 private:
     using base_type=GeneralComm<ThreadEnv,ThreadQueue>;
+    using arena_ptr=std::shared_ptr<tbb::task_arena>;
     friend ThreadEnv;///< Only Env can make comms
-    ThreadComm(ThreadEnv* Env);///Makes comm with \p NThreads nthreads
+    friend class TaskGraph;///< Submits straight to our queue
+    ThreadComm(ThreadEnv* Env);///Makes comm over all of \p Env's threads
+    
+    ///Makes a comm of \p NThreads threads that runs on \p Arena (NULL means
+    ///the Env's) and is cancelled with \p Token
+    ThreadComm(ThreadEnv* Env,size_t NThreads,arena_ptr Arena,
+               const CancelToken& Token);
+    
+    arena_ptr Arena_;///< Our own TBB arena, if split() made one
 public:
     ~ThreadComm();
     ThreadComm(ThreadComm&&)=default;
@@ -57,40 +70,141 @@ public:
     
     /** \brief Splits off a sub communicator for launching sub tasks.  
      * 
-     * At the moment \p n is ignored, but is eventually envisioned as allowing
-     * finer control over how many threads actually split off.  The reason it
-     * is ignored is that TBB actually will play nicely with other threading
-     * libraries (according to their documentation at least).  That being said
-     * you still should split the comm because the split is more for task
-     * dependencies.
+     * If \p n is 0, or at least size(), the new comm shares this comm's
+     * threads.  Otherwise it gets its own tbb::task_arena of \p n threads
+     * (counting the one that waits on it).  Everything the new comm runs,
+     * reduces included, stays on those threads: it can't take more than
+     * \p n threads from the rest of the program and other comms can't steal
+     * its work (nor it theirs).  The threads come out of the Env's total.
+     * For the NATIVE_ENGINE the comm's tasks still run in the Env's
+     * WorkStealingPool, but on at most \p n-1 of its threads at once plus
+     * the one waiting on them (see ThreadQueue).
+     * 
+     * Tasks do not need to call this to spawn sub tasks; the comm they are
+     * given is the one they were added to and it can be used directly.
+     * 
+     * The new comm is cancelled when this one is (see cancel()).
      */
     std::unique_ptr<ThreadComm> split(size_t n=0)const;
     
+    /** \brief Makes per-thread scratch objects for tasks to lease, copies of
+     *         \p Exemplar (see ThreadScratch)
+     * 
+     *  They must outlive the tasks that use them.
+     */
+    template<typename T>
+    std::unique_ptr<ThreadScratch<T>> make_scratch(const T& Exemplar=T())const
+    {
+        return std::unique_ptr<ThreadScratch<T>>(new ThreadScratch<T>(Exemplar));
+    }
+    
     size_t size()const;///< Returns the number of threads on this Comm   
     
+    /** \brief Stops this comm, and every comm split from it, from starting
+     *         any more tasks
+     * 
+     *  Tasks that are queued, or added later, are dropped; their futures
+     *  throw TaskCancelled.  Running tasks are not interrupted, but they can
+     *  poll cancelled() (on the comm they were given) and return early.
+     *  Typically you split() off a comm for a search and cancel it once the
+     *  answer is found; the comm you split it from is unaffected.  There is
+     *  no way to undo a cancel.
+     */
+    void cancel();
+    
+    bool cancelled()const;///< True once this comm (or a parent) was cancelled
+    
     /** \brief The main call for adding a task to a communicator
      * 
      *  The essence of task-based paralellism is well begin able to run tasks in
      *  parallel.  This function is the key to that.  Any callable entity given
      *  to it will be scheduled to run in parallel asynchronously.
      * 
-     *  Your function/functor/lambda needs to be callable via the signature:
+     *  Your function/functor/lambda is moved into the task, so it need not be
+     *  copyable, and needs to be callable via the signature:
      *  \code
      *  //Const is only needed if this is a member function
-     *  return_type operator()(ThreadComm)const;
+     *  return_type operator()(ThreadComm&)const;
      *  \endcode
      * 
+     *  The comm your functor receives is this comm, so nested calls to
+     *  add_task from inside a task go to the same queue.  The comm must
+     *  therefore outlive the tasks added to it (its destructor waits for them).
+     * 
+     *  If the queue already has plenty of work for every thread the task
+     *  is run right away on the calling thread instead (see Grains).
+     * 
+     *  Queued tasks are started highest priority first, so latency-critical
+     *  tasks don't wait behind background work (see Priorities).
+     * 
      *  \param[in] Fxn The function that will be called to run a task.
+     *  \param[in] Grain How much work the task is, only a hint
+     *  \param[in] Priority How urgent the task is
      *  \param[in] return_type The type of the value your function returns
      *  \return A future to the result of your task
      */
     template<typename return_type,typename functor_type>
-    ThreadFuture<return_type> add_task(functor_type&& Fxn)
+    ThreadFuture<return_type> add_task(functor_type&& Fxn,
+                                       Grains Grain=GRAIN_AUTO,
+                                       Priorities Priority=NORMAL_PRIORITY)
+    {
+        ThreadTask<return_type,functor_type,ThreadComm> 
+                Task(std::forward<functor_type>(Fxn),*this);
+        return Queue_->add_task(std::move(Task),Grain,Priority);
+    }
+    
+    ///add_task() with a priority, but no grain hint
+    template<typename return_type,typename functor_type>
+    ThreadFuture<return_type> add_task(functor_type&& Fxn,Priorities Priority)
+    {
+        return add_task<return_type>(std::forward<functor_type>(Fxn),
+                                     GRAIN_AUTO,Priority);
+    }
+    
+    /** \brief Adds a task that would like to run on NUMA node \p Node
+     * 
+     *  Like add_task(), but with the native engine and pinned threads (see
+     *  ThreadEnv) the task is queued for the threads of \p Node, which take
+     *  it before stealing elsewhere.  Threads of other nodes only take it
+     *  when they run out of work, and a get() on its future may still run it
+     *  wherever it is called.  Otherwise \p Node is ignored.  Continuations
+     *  of the task inherit its node.
+     * 
+     *  \param[in] Node A node of ThreadEnv::topology()
+     */
+    template<typename return_type,typename functor_type>
+    ThreadFuture<return_type> add_task_on(size_t Node,functor_type&& Fxn,
+                                          Priorities Priority=NORMAL_PRIORITY)
     {
         ThreadTask<return_type,functor_type,ThreadComm> 
                 Task(std::forward<functor_type>(Fxn),*this);
-        return Queue_->add_task(Task);
+        return Queue_->add_task(std::move(Task),GRAIN_AUTO,Priority,Node);
+    }
+    
+#ifdef LIBTASKFORCE_HAS_COROUTINES
+    /** \brief Adds a task that is a coroutine
+     * 
+     *  Like add_task(), except \p Fxn returns a CoTask<return_type> and may
+     *  co_await the futures of the tasks it adds.  While it waits its thread
+     *  is free to run other tasks; it is resumed by whichever thread finishes
+     *  what it awaits (see CoTask).  Coroutine tasks are always queued, never
+     *  run right away.
+     * 
+     *  Only available when compiled as C++20 (or later).
+     */
+    template<typename return_type,typename functor_type>
+    ThreadFuture<return_type> add_coroutine(functor_type&& Fxn,
+                                            Priorities Priority=NORMAL_PRIORITY)
+    {
+        using task_type=ThreadTask<CoTask<return_type>,functor_type,ThreadComm>;
+        CoroutineFrame<return_type,task_type>* Frame=
+            new CoroutineFrame<return_type,task_type>(
+                task_type(std::forward<functor_type>(Fxn),*this),Queue_.get());
+        Frame->Priority_=Priority;
+        Queue_->release_held(Frame);
+        return ThreadFuture<return_type>(Frame,*Queue_);
     }
+#endif
     
     /** \brief The main call for doing a reduce
      * 
@@ -132,6 +246,8 @@ public:
      *  \param[in] Fxn The operation that will be called on the range
      *  \param[in] Begin An iterator to the start of the range
      *  \param[in] End   An iterator just past the end of the range
+     *  \param[in] Mode  Whether the result needs to be reproducible, see
+     *                    ReduceModes
      *  \param[in] return_type The values of objects you are returning.  Must be
      *                         default initialized with default constructor and
      *                         assignable.
@@ -143,9 +259,236 @@ public:
      *
      */
     template<typename return_type,typename fxn_type,typename itr_type>
-    return_type reduce(const fxn_type& Fxn,itr_type Begin,itr_type End){
+    return_type reduce(const fxn_type& Fxn,itr_type Begin,itr_type End,
+                       ReduceModes Mode=FAST_REDUCE){
         ReduceTask<return_type,fxn_type> Task(Fxn);
-        return Queue_->reduce(Task,Begin,End);
+        return Queue_->isolate([&](){
+            if(Mode==DETERMINISTIC_REDUCE)
+                return Queue_->deterministic_reduce(Task,Begin,End);
+            return Queue_->reduce(Task,Begin,End);
+        });
+    }
+    
+    /** \brief A reduce over values that are read (or made) as it goes
+     * 
+     *  reduce() needs random access iterators, i.e. all the input in memory
+     *  at once.  This instead pulls chunks of \p ChunkSize values from a
+     *  generator and reduces them while it reads the next ones, keeping only
+     *  a few chunks per thread in memory.  The generator is only called from
+     *  the calling thread and must have the signature:
+     *  \code
+     *  //Puts the next value in Value, returns false if there are no more
+     *  bool operator()(value_type& Value);
+     *  \endcode
+     * 
+     *  The functor is the same as for reduce(), except that the dereference
+     *  function is given a std::vector<value_type>::const_iterator into the
+     *  chunk, not one into your input.
+     * 
+     *  \code
+     *  size_t i=0;
+     *  auto Count=[&i,N](double& x){x=(double)++i;return i<=N;};
+     *  double Sum=Comm.stream_reduce<double,double>(MyFunctor(),Count);
+     *  \endcode
+     * 
+     *  \param[in] Fxn The dereference function and operation
+     *  \param[in] Generator Where the values come from
+     *  \param[in] ChunkSize How many values are reduced by one task
+     *  \return The reduced value
+     */
+    template<typename return_type,typename value_type,typename fxn_type,
+             typename generator_type>
+    return_type stream_reduce(const fxn_type& Fxn,generator_type&& Generator,
+                              size_t ChunkSize=4096){
+        return Queue_->isolate([&](){
+            return Queue_->stream_reduce<return_type,value_type>(Fxn,Generator,
+                                                                 ChunkSize);
+        });
+    }
+    
+    ///stream_reduce() over a range that only needs forward iterators
+    template<typename return_type,typename fxn_type,typename itr_type>
+    return_type stream_reduce(const fxn_type& Fxn,itr_type Begin,itr_type End,
+                              size_t ChunkSize=4096){
+        using value_type=typename std::iterator_traits<itr_type>::value_type;
+        auto Generator=[&Begin,End](value_type& Value){
+            if(Begin==End)return false;
+            Value=*Begin;
+            ++Begin;
+            return true;
+        };
+        return Queue_->isolate([&](){
+            return Queue_->stream_reduce<return_type,value_type>(Fxn,Generator,
+                                                                 ChunkSize);
+        });
+    }
+    
+    /** \brief A parallel prefix scan (running reduction) of a range
+     * 
+     *  Uses the same functor as reduce(): a dereference function and an
+     *  associative operation, with a default constructed return_type as the
+     *  identity.  For the range x0,x1,x2,... the inclusive scan writes
+     *  x0,x0+x1,x0+x1+x2,... to \p Out and the exclusive one writes
+     *  0,x0,x0+x1,..., where "+" is your operation.  \p Out may be \p Begin
+     *  (if the types allow), which scans in place.
+     * 
+     *  A typical use is turning per-item output sizes into offsets:
+     *  \code
+     *  std::vector<size_t> Offsets(Sizes.size());
+     *  size_t Total=Comm.scan<size_t>(Fxn,Sizes.cbegin(),Sizes.cend(),
+     *                                 Offsets.begin(),false);
+     *  \endcode
+     * 
+     *  Like reduce() this blocks until it is done.  \p Begin and \p Out must
+     *  be random access iterators.
+     * 
+     *  \param[in] Fxn The dereference function and operation
+     *  \param[in] Begin An iterator to the start of the range
+     *  \param[in] End   An iterator just past the end of the range
+     *  \param[out] Out  Where the scan goes, the same length as the range
+     *  \param[in] Inclusive True for an inclusive scan, false for exclusive
+     *  \return The reduction of the whole range
+     */
+    template<typename return_type,typename fxn_type,typename itr_type,
+             typename out_itr>
+    return_type scan(const fxn_type& Fxn,itr_type Begin,itr_type End,
+                     out_itr Out,bool Inclusive=true){
+        return Queue_->isolate([&](){
+            return Queue_->scan<return_type>(Fxn,Begin,End,Out,Inclusive);
+        });
+    }
+    
+    /** \brief A reduce that produces one value per key (a "group by")
+     * 
+     *  Histograms, per-key sums, and the like.  Your functor must define:
+     *  \code
+     *  //Maps an element of the range to its key and value
+     *  std::pair<key_type,value_type> operator()(itr_type)const;
+     * 
+     *  //Combines two values with the same key
+     *  value_type operator()(value_type,value_type)const;
+     *  \endcode
+     * 
+     *  key_type needs std::hash and operator==, and both types must be
+     *  default constructible.  Each thread accumulates into its own
+     *  open-addressing hash table, and the tables are merged in parallel.
+     *  Unlike reduce() no identity value is assumed: a key's value is the
+     *  combination of the values seen for it.  Threads see the elements in
+     *  no particular order, so the operation must be associative and
+     *  commutative.
+     * 
+     *  \param[in] Fxn The key/value function and operation
+     *  \param[in] Begin An iterator to the start of the range
+     *  \param[in] End   An iterator just past the end of the range
+     *  \return One (key,value) pair per distinct key, in no particular order
+     */
+    template<typename key_type,typename value_type,typename fxn_type,
+             typename itr_type>
+    std::vector<std::pair<key_type,value_type>>
+    group_reduce(const fxn_type& Fxn,itr_type Begin,itr_type End){
+        return Queue_->isolate([&](){
+            return Queue_->group_reduce<key_type,value_type>(Fxn,Begin,End);
+        });
+    }
+    
+    /** \brief group_reduce() for keys that are the integers [0,NKeys)
+     * 
+     *  Per-thread arrays replace the hash tables, which is much faster when
+     *  the keys are dense.  The functor returns std::pair<size_t,value_type>
+     *  (any integral key type works).  As with reduce(), a default
+     *  constructed value_type is the identity; keys that never occur get it.
+     * 
+     *  \return The value for key i at index i
+     */
+    template<typename value_type,typename fxn_type,typename itr_type>
+    std::vector<value_type> dense_group_reduce(const fxn_type& Fxn,
+                                               itr_type Begin,itr_type End,
+                                               size_t NKeys){
+        return Queue_->isolate([&](){
+            return Queue_->dense_group_reduce<value_type>(Fxn,Begin,End,NKeys);
+        });
+    }
+    
+    /** \brief A reduce whose functor works on whole chunks of the range
+     * 
+     *  reduce() calls your functor once per element, so the compiler cannot
+     *  vectorize across elements.  Here it is instead called once per chunk
+     *  of at least \p Grain contiguous elements, and must define:
+     *  \code
+     *  //Reduce the elements in [Begin,End), never empty
+     *  return_type operator()(itr_type Begin,itr_type End)const;
+     * 
+     *  //Combine two partial results
+     *  return_type operator()(return_type,return_type)const;
+     *  \endcode
+     * 
+     *  ReduceKernels.hpp has vectorized kernels for sums, minima, maxima,
+     *  and dot products of arithmetic types:
+     *  \code
+     *  double Sum=Comm.chunk_reduce<double>(SumKernel<double>(),
+     *                                       X.begin(),X.end());
+     *  \endcode
+     * 
+     *  \param[in] Fxn The chunk and combine operations
+     *  \param[in] Begin An iterator to the start of the range
+     *  \param[in] End   An iterator just past the end of the range
+     *  \param[in] Grain The fewest elements worth putting in a chunk
+     *  \return The reduced value (a default constructed one for an empty
+     *          range)
+     */
+    template<typename return_type,typename fxn_type,typename itr_type>
+    return_type chunk_reduce(const fxn_type& Fxn,itr_type Begin,itr_type End,
+                             size_t Grain=4096){
+        ChunkReduceTask<return_type,fxn_type> Task(Fxn);
+        return Queue_->isolate([&](){
+            return Queue_->reduce(Task,Begin,End,Grain);
+        });
+    }
+    
+    /** \brief Calls a function on each element of a range, in parallel
+     * 
+     *  Like reduce() this blocks until the whole range has been processed.
+     *  The range [Begin,End) may be a range of indices or of random access
+     *  iterators; either way \p Fxn is called with each one:
+     *  \code
+     *  void operator()(index_type)const;
+     *  \endcode
+     * 
+     *  The range is recursively split into chunks of no fewer than \p Grain
+     *  elements, how far is up to \p Partitioner.  For AFFINITY_PARTITIONER
+     *  the comm keeps one LoopAffinity, so repeated calls over the same
+     *  range reuse the same chunk to thread mapping.  If you alternate
+     *  between several loops, or run loops on this comm concurrently, give
+     *  each its own LoopAffinity with the other overload.
+     * 
+     *  \code
+     *  std::vector<double> X(N);
+     *  Comm.parallel_for(size_t(0),N,[&](size_t i){X[i]=f(i);});
+     *  \endcode
+     * 
+     *  \param[in] Begin The first index
+     *  \param[in] End Just past the last index
+     *  \param[in] Fxn The function to call on each index
+     *  \param[in] Partitioner How to divide the range into chunks
+     *  \param[in] Grain The smallest chunk worth giving a thread
+     */
+    template<typename index_type,typename fxn_type>
+    void parallel_for(index_type Begin,index_type End,const fxn_type& Fxn,
+                      Partitioners Partitioner=AUTO_PARTITIONER,size_t Grain=1)
+    {
+        Queue_->isolate([&](){
+            Queue_->parallel_for(Begin,End,Fxn,Grain,Partitioner);
+        });
+    }
+    
+    ///Same as above, but uses (and updates) the mapping in \p Affinity
+    template<typename index_type,typename fxn_type>
+    void parallel_for(index_type Begin,index_type End,const fxn_type& Fxn,
+                      LoopAffinity& Affinity,size_t Grain=1)
+    {
+        Queue_->isolate([&](){
+            Queue_->parallel_for(Begin,End,Fxn,Grain,Affinity);
+        });
     }
 };
 
@@ -19,20 +19,64 @@
  *   along with LibTaskForce.  If not, see <http://www.gnu.org/licenses/>.
  */ 
 
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+#include <thread>
+#include <tbb/task_group.h>
 #include <tbb/task_scheduler_init.h>
+#include <tbb/task_scheduler_observer.h>
 #include "LibTaskForce/Threading/ThreadEnv.hpp"
+#include "LibTaskForce/Threading/NumaTopology.hpp"
 #include "LibTaskForce/Threading/ThreadComm.hpp"
+#include "LibTaskForce/Threading/WorkStealingPool.hpp"
 
 inline size_t GetNThreads(size_t NThreads)
 {
-    return !NThreads?tbb::task_scheduler_init::default_num_threads():NThreads;
+    return !NThreads?LibTaskForce::ThreadEnv::default_size():NThreads;
 }
 
 namespace LibTaskForce{
 
-ThreadEnv::ThreadEnv(size_t NThreads):
+///Pins each of TBB's workers to a CPU the first time it joins the scheduler
+class PinningObserver: public tbb::task_scheduler_observer{
+private:
+    const NumaTopology& Topology_;///< Where the CPUs are
+    size_t SpreadOffset_;///< Where in the spread our threads start
+    std::atomic<size_t> NPinned_;///< Workers pinned so far
+public:
+    PinningObserver(const NumaTopology& Topology,size_t SpreadOffset):
+        Topology_(Topology),SpreadOffset_(SpreadOffset),NPinned_(0)
+    {
+        observe(true);
+    }
+    
+    ~PinningObserver(){observe(false);}
+    
+    void on_scheduler_entry(bool IsWorker)
+    {
+        static thread_local const PinningObserver* PinnedBy=nullptr;
+        if(!IsWorker || PinnedBy==this)return;
+        PinnedBy=this;
+        //The first spot in the spread is the master's, like with the pool
+        NumaTopology::pin_thread(Topology_.spread_cpu(SpreadOffset_+
+                                                      (++NPinned_)));
+    }
+};
+
+ThreadEnv::ThreadEnv(size_t NThreads,Engines Engine,Pinnings Pinning,
+                     size_t SpreadOffset):
     NThreads_(GetNThreads(NThreads)),
-    TaskScheduler_(new tbb::task_scheduler_init((int)NThreads_))
+    Pinning_(Pinning),
+    IdlePolicy_(IDLE_SLEEP),
+    SpinTime_(0),
+    Topology_(new NumaTopology),
+    TaskScheduler_(new tbb::task_scheduler_init((int)NThreads_)),
+    Observer_(Engine==TBB_ENGINE && Pinning==PIN_THREADS?
+              new PinningObserver(*Topology_,SpreadOffset):nullptr),
+    Pool_(Engine==NATIVE_ENGINE?new WorkStealingPool(NThreads_,
+              Pinning==PIN_THREADS?Topology_.get():nullptr,SpreadOffset):
+              nullptr)
 {
     FirstComm_=std::unique_ptr<ThreadComm>(new ThreadComm(this));
 }
@@ -41,8 +85,58 @@ ThreadEnv::ThreadEnv(size_t NThreads):
 ThreadEnv::~ThreadEnv(){
         while(!Comms_.empty())Comms_.pop();
         FirstComm_.reset();
+        Pool_.reset();
+        Observer_.reset();
         TaskScheduler_.reset();
     }
 
+size_t ThreadEnv::default_size(size_t NSharing)
+{
+    return std::max<size_t>(1,NumaTopology().ncpus()/std::max<size_t>(1,NSharing));
+}
+
+void ThreadEnv::set_idle_policy(IdlePolicies Policy,
+                                std::chrono::microseconds SpinTime)
+{
+    IdlePolicy_=Policy;
+    SpinTime_=SpinTime;
+    if(Pool_)Pool_->set_idle_policy(Policy,SpinTime);
+}
+
+bool ThreadEnv::warm_up()
+{
+    if(Pool_)return Pool_->warm_up();
+    //Each task holds its thread until every thread has one
+    const std::chrono::steady_clock::time_point Deadline=
+        std::chrono::steady_clock::now()+WorkStealingPool::WarmUpTime;
+    std::atomic<size_t> NArrived(0);
+    tbb::task_group Group;
+    for(size_t i=0;i<NThreads_;++i)
+        Group.run([&](){
+            WorkStealingPool::touch_stack();
+            ++NArrived;
+            while(NArrived.load()<NThreads_ &&
+                  std::chrono::steady_clock::now()<Deadline)
+                std::this_thread::yield();
+        });
+    Group.wait();
+    return NArrived.load()>=NThreads_;
+}
+
+Engines ThreadEnv::engine()const
+{
+    return Pool_?NATIVE_ENGINE:TBB_ENGINE;
+}
+
+std::string ThreadEnv::print()const
+{
+    std::stringstream ss;
+    ss<<"Environment has "<<NThreads_<<" threads using the "
+      <<(Pool_?"native":"TBB")<<" engine"
+      <<(Pinning_==PIN_THREADS?", pinned":"")<<std::endl<<Topology_->print();
+    if(Pool_)ss<<Pool_->print();
+    return ss.str();
+}
+
 
 }//end namespace
\ No newline at end of file
@@ -29,8 +29,12 @@
 #ifndef LIBTASKFORCE_GUARD_THREADENV_HPP
 #define LIBTASKFORCE_GUARD_THREADENV_HPP
 
+#include<chrono>
 #include<memory>
+#include<string>
+#include<ostream>
 #include "LibTaskForce/General/GeneralEnv.hpp"
+#include "LibTaskForce/Threading/WorkStealingPool.hpp"
 
 namespace tbb{
 class task_scheduler_init;
@@ -38,6 +42,20 @@ class task_scheduler_init;
 
 namespace LibTaskForce {
 class ThreadComm;
+class NumaTopology;
+class PinningObserver;
+
+///The schedulers ThreadComm::add_task can run on
+enum Engines {
+    TBB_ENGINE,   ///< Tasks go to a tbb::task_group
+    NATIVE_ENGINE ///< Tasks go to our WorkStealingPool
+};
+
+///Whether the worker threads are pinned to CPUs
+enum Pinnings {
+    NO_PINNING, ///< The OS places the threads
+    PIN_THREADS ///< Workers are pinned to CPUs spread over the NUMA nodes
+};
 
 
 /** \brief This class is in charge of managing the threading environment
@@ -47,26 +65,99 @@ class ThreadComm;
  *  to control the number of threads by making a tbb::task_scheduler_init
  *  instance.  This class is designed to allow for multiple instances
  *  although doing so is probably not a great idea.
+ * 
+ *  Tasks added via ThreadComm::add_task can instead be run by our own
+ *  WorkStealingPool by asking for the NATIVE_ENGINE.  The TBB scheduler is
+ *  started either way because reduce() always goes through TBB.
+ * 
+ *  ThreadComm::split() can carve smaller comms out of this env's threads.
  */
 class ThreadEnv: public GeneralEnv<ThreadComm>{
 private:
     size_t NThreads_;//< The number of threads we have
+    Pinnings Pinning_;///< Whether our workers are pinned
+    IdlePolicies IdlePolicy_;///< What idle native workers do
+    std::chrono::microseconds SpinTime_;///< How long IDLE_SPIN workers poll
+    ///The NUMA nodes and CPUs we may run on
+    std::unique_ptr<NumaTopology> Topology_;
     ///TBB's task scheduler
     std::unique_ptr<tbb::task_scheduler_init> TaskScheduler_;
+    ///Pins TBB's workers, only made for the TBB_ENGINE with PIN_THREADS
+    std::unique_ptr<PinningObserver> Observer_;
+    ///Our own scheduler, only made for the NATIVE_ENGINE
+    std::unique_ptr<WorkStealingPool> Pool_;
     friend ThreadComm;    
 public:
     /** \brief Starts the threading environment up
      *
      *  \param[in] NThreads The number of threads this env can use.  Default is
-     *                      1.  You may specify 0 to have  TBB choose for you.
+     *                      1.  You may specify 0 for default_size().
+     *  \param[in] Engine   Which scheduler runs tasks.  Default is TBB.
+     *  \param[in] Pinning  Whether to pin the workers.  Pinned workers are
+     *                      spread over the NUMA nodes (see
+     *                      NumaTopology::spread_cpu()); the calling thread
+     *                      is never pinned.  With the native engine,
+     *                      stealing then prefers the same node and tasks
+     *                      can ask for a node (see ThreadComm::add_task_on).
+     *                      Default is no pinning.
+     *  \param[in] SpreadOffset Where in the spread pinned threads start:
+     *                      worker i goes to spread_cpu(SpreadOffset+i).
+     *                      Processes that share CPUs must use disjoint parts
+     *                      of it, or they pin their workers to the same
+     *                      CPUs; e.g. each passes its index among them times
+     *                      \p NThreads, as HybridEnv does.
      */
-    ThreadEnv(size_t NThreads=1);
+    ThreadEnv(size_t NThreads=1,Engines Engine=TBB_ENGINE,
+              Pinnings Pinning=NO_PINNING,size_t SpreadOffset=0);
     
     ///Need to manually free pointers in right order or we get a TBB warning
     ~ThreadEnv();
     
     size_t size()const{return NThreads_;}
     
+    /** \brief The default number of threads: the CPUs in our affinity mask,
+     *         split evenly between the \p NSharing processes that use them
+     * 
+     *  Never less than 1.  HybridEnv works out \p NSharing for its node.
+     */
+    static size_t default_size(size_t NSharing=1);
+    
+    Engines engine()const;///< Which scheduler is running our tasks
+    
+    Pinnings pinning()const{return Pinning_;}///< Whether workers are pinned
+    
+    ///The NUMA nodes and CPUs available to us
+    const NumaTopology& topology()const{return *Topology_;}
+    
+    /** \brief Sets what idle workers do (see IdlePolicies)
+     * 
+     *  Applies to the native engine's pool, which split comms share.  TBB
+     *  offers no control over its idle workers, so with the TBB engine this
+     *  does nothing.
+     * 
+     *  \param[in] Policy What workers do while they can't find work
+     *  \param[in] SpinTime How long IDLE_SPIN workers poll before they sleep
+     */
+    void set_idle_policy(IdlePolicies Policy,
+        std::chrono::microseconds SpinTime=std::chrono::microseconds(100));
+    
+    IdlePolicies idle_policy()const{return IdlePolicy_;}///< What idle workers do
+    
+    /** \brief Gets every worker running and touches its stack
+     * 
+     *  Call this right before a timed or latency-sensitive region, so the
+     *  first tasks don't pay for waking threads and faulting in stack pages.
+     *  With IDLE_SPIN or IDLE_YIELD the workers then stay awake for it.
+     *  Returns once all workers have checked in, or after
+     *  WorkStealingPool::WarmUpTime if some don't (e.g. they are busy
+     *  with a long task, or TBB won't give us all of them).
+     * 
+     *  \return True if every worker checked in in time
+     */
+    bool warm_up();
+    
+    std::string print()const;///< Describes the env, including scheduler stats
+    
     ///Copy/Assignment Constructors
     /**@{*/
     ThreadEnv(const ThreadEnv&)=delete;
@@ -76,6 +167,10 @@ public:
     /**@}*/
 };
 
+inline std::ostream& operator<<(std::ostream& os, const ThreadEnv& Env){
+    return os<<Env.print();
+}
+
 }//End namespace LIbTaskForce
 #endif /* LIBTASKFORCE_GUARD_THREADENV_HPP */
 
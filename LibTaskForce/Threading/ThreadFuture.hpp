@@ -29,8 +29,13 @@
 #ifndef LIBTASKFORCE_GUARD_THREADFUTURE_HPP
 #define LIBTASKFORCE_GUARD_THREADFUTURE_HPP
 
-#include <future>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <type_traits>
 #include "LibTaskForce/Threading/ThreadQueue.hpp"
+#include "LibTaskForce/Util/ParallelAssert.hpp"
 
 namespace LibTaskForce {
 class ThreadQueue;
@@ -40,15 +45,50 @@ class ThreadQueue;
 template<typename ReturnT>
 class ThreadFuture{
     private:
-        using future_type=std::future<ReturnT>;///< Type of future 2 result
+        using frame_type=ResultFrame<ReturnT>;///< Where our result is
         using queue_type=ThreadQueue;///< Type of the queue
         using my_type=ThreadFuture<ReturnT>;///< The type of this class
-        future_type DaFuture_;///< The result we are going to return
-        queue_type& Parent_;///< The task that is waiting for this future
+        
+        ///How many times get() looks for work in vain before it parks
+        static const size_t NSpins=64;
+        
+        template<typename> friend struct FutureAwaiter;///< For co_await
+        
+        ///The frame of our task, NULL once the value was taken
+        std::unique_ptr<frame_type,FrameReleaser> Frame_;
+        queue_type* Parent_;///< The task that is waiting for this future
+        
+        ///True if the task behind this future has finished
+        bool Ready()const
+        {
+            return Frame_->Result_.ready();
+        }
+        
+        /** \brief Waits for our task to finish
+         * 
+         *  If no thread has started the task yet we run it ourselves.
+         *  Otherwise we run other pending tasks while we wait.  If there are
+         *  none for a while we park, but only briefly, so that we can go back
+         *  to helping if new work shows up.
+         * 
+         *  A coroutine task is done once it co_returns, not when the call
+         *  that started it returns.
+         */
+        void Wait()
+        {
+            PARALLEL_ASSERT(Frame_!=nullptr,"This future's value was already taken");
+            //A coroutine may only have gotten to its first co_await
+            if(Frame_->try_run())Parent_->drop_stale();
+            for(size_t NIdle=0;!Ready();){
+                if(Parent_->help())NIdle=0;
+                else if(++NIdle<NSpins)std::this_thread::yield();
+                else Frame_->Result_.wait_for(std::chrono::milliseconds(1));
+            }
+        }
     public:
         
-        ThreadFuture(future_type&& Future,queue_type& Parent):
-            DaFuture_(std::move(Future)),Parent_(Parent)
+        ThreadFuture(frame_type* Frame,queue_type& Parent):
+            Frame_(Frame),Parent_(&Parent)
             {}
         ~ThreadFuture()=default;
         
@@ -60,11 +100,82 @@ class ThreadFuture{
         my_type& operator=(const my_type&)=delete;
         /**@}*/
         
-        ///Returns the value this future is in charge of
+        ///True until the value has been taken (or handed to then())
+        bool valid()const{return Frame_!=nullptr;}
+        
+        ///True if the value is available, never blocks
+        bool is_ready()const
+        {
+            PARALLEL_ASSERT(Frame_!=nullptr,"This future's value was already taken");
+            return Ready();
+        }
+        
+        /** \brief Waits at most \p Timeout for the value to be available
+         * 
+         *  While waiting we run other pending tasks, so we may return a bit
+         *  after \p Timeout if one of those takes a while.
+         * 
+         *  \return True if the value is available
+         */
+        template<typename Rep,typename Period>
+        bool wait_for(const std::chrono::duration<Rep,Period>& Timeout)
+        {
+            PARALLEL_ASSERT(Frame_!=nullptr,"This future's value was already taken");
+            using clock_type=std::chrono::steady_clock;
+            const clock_type::time_point End=clock_type::now()+
+                std::chrono::duration_cast<clock_type::duration>(Timeout);
+            while(!Ready()){
+                const clock_type::time_point Now=clock_type::now();
+                if(Now>=End)return false;
+                if(!Parent_->help())
+                    Frame_->Result_.wait_for(std::min<clock_type::duration>(
+                        End-Now,std::chrono::milliseconds(1)));
+            }
+            return true;
+        }
+        
+        /** \brief Returns the value this future is in charge of
+         * 
+         *  Only waits for this future's task, not for the rest of the queue.
+         *  The value is moved out, not copied, so this may only be called
+         *  once (see value() for repeated reads).
+         */
         ReturnT get()
         {
-            Parent_.wait();
-            return DaFuture_.get();
+            Wait();
+            std::unique_ptr<frame_type,FrameReleaser> Frame(std::move(Frame_));
+            return Frame->Result_.get();
+        }
+        
+        /** \brief Returns a reference to the value, for repeated reads
+         * 
+         *  Waits like get() does, but the value stays in the future and the
+         *  future remains valid.  The reference is good until the value is
+         *  taken with get() or then(), or the future is destroyed.
+         */
+        const ReturnT& value()
+        {
+            Wait();
+            return Frame_->Result_.value();
+        }
+        
+        /** \brief Schedules \p Fxn to be called with this future's value
+         *         once it's ready, without waiting for it
+         * 
+         *  The continuation runs as a task on the same queue.  If our task
+         *  threw, \p Fxn is not called and the exception is passed on to the
+         *  returned future instead.  Consumes this future.
+         * 
+         *  \param[in] Fxn A functor taking a ReturnT
+         *  \return A future to the result of \p Fxn
+         */
+        template<typename FxnType>
+        ThreadFuture<typename std::result_of<FxnType(ReturnT)>::type>
+        then(FxnType&& Fxn)
+        {
+            PARALLEL_ASSERT(Frame_!=nullptr,"This future's value was already taken");
+            return Parent_->add_continuation(std::move(Frame_),
+                                             std::forward<FxnType>(Fxn));
         }
 };
 
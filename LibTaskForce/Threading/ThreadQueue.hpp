@@ -37,41 +37,575 @@ PRAGMA_WARNING_IGNORE_FP_EQUALITY
 #include <tbb/tbb.h>
 PRAGMA_WARNING_POP
 
+#include<algorithm>
+#include<atomic>
+#include<iterator>
+#include<memory>
+#include<new>
+#include<numeric>
 #include<type_traits>
+#include<thread>
+#include<vector>
+#include "LibTaskForce/Threading/CancelToken.hpp"
+#include "LibTaskForce/Threading/FramePool.hpp"
+#include "LibTaskForce/Threading/GroupTable.hpp"
+#include "LibTaskForce/Threading/Partitioners.hpp"
+#include "LibTaskForce/Threading/ResultSlot.hpp"
+#include "LibTaskForce/Threading/WorkStealingPool.hpp"
+#include "LibTaskForce/Util/ParallelAssert.hpp"
 
 namespace LibTaskForce {
 template<typename T> class ThreadFuture;
+class ThreadQueue;
 
-//TBB doesn't support move semantics yet, so fake them...
+/** \brief The part of a task frame that does not depend on the task
+ * 
+ *  A frame is referenced by two parties: the scheduler, which will eventually
+ *  call execute(), and the task's future, which may run the task itself via
+ *  try_run() if no thread has started it yet.  Whoever claims the frame first
+ *  runs the task; the frame is freed when both parties have released it.
+ * 
+ *  A frame may also have one continuation (see ThreadFuture::then()), which
+ *  is handed to the scheduler once this frame's task is done.
+ */
+struct TaskFrameBase:public PoolTask{
+    ThreadQueue* Queue_;///< The queue the task was added to
+    std::atomic<bool> Claimed_;///< Set by whoever runs the task
+    std::atomic<int> NRefs_;///< The scheduler and the future
+    ///The continuation, or this frame itself once the task is done
+    std::atomic<TaskFrameBase*> Next_;
+    ///Set by compute() if it only started the task, which will call finish()
+    ///itself when it is done (see CoroutineFrame)
+    bool Deferred_;
+    
+    TaskFrameBase(ThreadQueue* Queue,bool Held=false):
+        Queue_(Queue),Claimed_(Held),NRefs_(2),Next_(nullptr),Deferred_(false)
+    {}
+    
+    ///Puts the result of the task in the derived class's slot
+    virtual void compute()=0;
+    
+    ///Puts a TaskCancelled exception in the slot instead
+    virtual void abandon()=0;
+    
+    ///Runs the task if nobody else has claimed it, true if we ran it (or,
+    ///if it's Deferred_, started it)
+    inline bool try_run();
+    
+    ///Marks the task done and schedules its continuation, if any
+    inline void finish();
+    
+    /** \brief Runs the task on the calling thread, for tasks that never go
+     *         to the scheduler
+     * 
+     *  Must be called before anyone else can see the frame, which is what
+     *  lets it skip the atomic read-modify-writes of try_run().
+     */
+    inline void run_inline();
+    
+    /** \brief Makes a finished frame held again, as if it was just made with
+     *         \p Held set, so it can run again
+     * 
+     *  Only valid once the scheduler has released the frame, i.e. when the
+     *  caller holds the only reference (see TaskGraph).
+     */
+    virtual void rearm()
+    {
+        Deferred_=false;
+        Claimed_.store(true,std::memory_order_relaxed);
+        NRefs_.store(2,std::memory_order_relaxed);
+        Next_.store(nullptr,std::memory_order_relaxed);
+    }
+    
+    ///Gives up a reference to the frame
+    void release()
+    {
+        //If ours is the only reference nobody else can change the count
+        if(NRefs_.load(std::memory_order_acquire)==1 || !--NRefs_)delete this;
+    }
+    
+    bool stale()const
+    {
+        return Claimed_.load(std::memory_order_relaxed);
+    }
+    
+    ///Called by the scheduler
+    void execute()
+    {
+        try_run();
+        release();
+    }
+    
+    ///Frames are recycled through the FramePool
+    ///@{
+    static void* operator new(size_t Size){return FramePool::allocate(Size);}
+    static void operator delete(void* Ptr,size_t Size)
+    {
+        FramePool::deallocate(Ptr,Size);
+    }
+    ///@}
+    
+#ifdef __cpp_aligned_new
+    ///Over-aligned frames (e.g. of alignas(64) results) only use the
+    ///FramePool if its Alignment is enough
+    ///@{
+    static void* operator new(size_t Size,std::align_val_t Align)
+    {
+        if(static_cast<size_t>(Align)<=FramePool::Alignment)
+            return FramePool::allocate(Size);
+        return ::operator new(Size,Align);
+    }
+    static void operator delete(void* Ptr,size_t Size,std::align_val_t Align)
+    {
+        if(static_cast<size_t>(Align)<=FramePool::Alignment)
+            return FramePool::deallocate(Ptr,Size);
+        ::operator delete(Ptr,Size,Align);
+    }
+    ///@}
+#endif
+};
+
+/** \brief Fails to compile if frames of type \p Frame can't be allocated
+ *         with their alignment
+ * 
+ *  Before C++17 new ignores alignments beyond the default, so FramePool's
+ *  Alignment is the most a frame can have.
+ */
+template<typename Frame>
+void check_frame_alignment()
+{
+#ifndef __cpp_aligned_new
+    static_assert(alignof(Frame)<=FramePool::Alignment,
+                  "Tasks and results aligned beyond a cache line need C++17");
+#endif
+}
+
+///Releases a frame instead of deleting it
+struct FrameReleaser{
+    void operator()(TaskFrameBase* Frame)const{Frame->release();}
+};
+
+///The part of a task frame that depends only on the type of the result
+template<typename T>
+struct ResultFrame:public TaskFrameBase{
+    ResultSlot<T> Result_;///< Where the task puts its result
+    
+    ResultFrame(ThreadQueue* Queue,bool Held=false):
+        TaskFrameBase(Queue,Held)
+    {}
+    
+    void abandon()
+    {
+        Result_.set_exception(std::make_exception_ptr(TaskCancelled()));
+    }
+    
+    void rearm()
+    {
+        TaskFrameBase::rearm();
+        Result_.reset();
+    }
+};
+
+/** \brief What a task lives in between being added and being run
+ * 
+ *  Frames hold the task and its result by value and get their memory from
+ *  the FramePool, so the only things that go to the schedulers are pointers
+ *  to frames.
+ */
 template<typename TaskType>
-struct ThreadWrapper{
-    const TaskType& Task_;
+struct TaskFrame:public ResultFrame<typename TaskType::return_type>{
+    TaskType Task_;///< The task to run
+    
+    TaskFrame(TaskType&& Task,ThreadQueue* Queue,bool Held=false):
+        ResultFrame<typename TaskType::return_type>(Queue,Held),
+        Task_(std::move(Task))
+    {
+        check_frame_alignment<TaskFrame>();
+    }
+    
+    void compute(){Task_.run(this->Result_);}
+};
+
+/** \brief The frame of a continuation made by ThreadFuture::then()
+ * 
+ *  Continuation frames start out claimed, so neither their future nor a
+ *  scheduler can run them, and the antecedent's frame unclaims them when it
+ *  hands them to the scheduler.
+ */
+template<typename T,typename FxnType>
+struct ContinuationFrame:
+    public ResultFrame<typename std::result_of<FxnType(T)>::type>{
+    using antecedent_ptr=std::unique_ptr<ResultFrame<T>,FrameReleaser>;
+    antecedent_ptr Antecedent_;///< The frame whose result we consume
+    FxnType Fxn_;///< What we do with that result
+    
+    ContinuationFrame(antecedent_ptr Antecedent,FxnType&& Fxn,
+                      ThreadQueue* Queue):
+        ResultFrame<typename std::result_of<FxnType(T)>::type>(Queue,true),
+        Antecedent_(std::move(Antecedent)),Fxn_(std::forward<FxnType>(Fxn))
+    {
+        check_frame_alignment<ContinuationFrame>();
+    }
+    
+    void compute()
+    {
+        antecedent_ptr Antecedent(std::move(Antecedent_));
+        try{
+            this->Result_.set_value(Fxn_(Antecedent->Result_.get()));
+        }
+        catch(...){
+            this->Result_.set_exception(std::current_exception());
+        }
+    }
+};
+
+/** \brief A task of the env's WorkStealingPool that runs a ThreadQueue's
+ *         pending tasks (see ThreadQueue::submit())
+ */
+struct QueueRunner:public PoolTask{
+    ThreadQueue* Queue_;///< Whose tasks we run
     
-    ThreadWrapper(const TaskType& Task):
-        Task_(Task){}
+    explicit QueueRunner(ThreadQueue* Queue):Queue_(Queue){}
     
-    void operator()()const
+    ///Called by the pool, frees the runner
+    inline void execute();
+    
+    ///Runners are recycled through the FramePool
+    ///@{
+    static void* operator new(size_t Size){return FramePool::allocate(Size);}
+    static void operator delete(void* Ptr,size_t Size)
     {
-        Task_();
+        FramePool::deallocate(Ptr,Size);
     }
-                
+    ///@}
+};
+
+/** \brief Hints about how much work a task is
+ * 
+ *  Spawning a task that does very little costs more than just running it.
+ *  add_task() therefore runs tasks inline, on the calling thread, when the
+ *  queue already has plenty of work for every thread.  The hint adjusts how
+ *  much is "plenty".
+ */
+enum Grains{
+    GRAIN_AUTO,///< Inline once there are a few queued tasks per thread
+    GRAIN_FINE,///< Inline once there is one queued task per thread
+    GRAIN_COARSE///< Never inline
 };
 
-///Abstracts away the actual queue implementation
+/** \brief How ThreadComm::reduce combines partial results
+ * 
+ *  TBB splits the range differently from run to run, so with floating
+ *  point types the result of a FAST_REDUCE can differ in the last bits
+ *  between runs and thread counts.  A DETERMINISTIC_REDUCE always combines
+ *  in the same order (see ThreadQueue::deterministic_reduce()).
+ */
+enum ReduceModes{
+    FAST_REDUCE,///< Let TBB decide how to split the range
+    DETERMINISTIC_REDUCE///< Fixed blocks and a fixed pairwise tree
+};
+
+/** \brief Abstracts away the actual queue implementation
+ * 
+ *  If the env was made with the NATIVE_ENGINE tasks go to its
+ *  WorkStealingPool, which also supplies the work for help().  What follows
+ *  describes the TBB engine, and queues of the native engine that may only
+ *  use some of the pool's threads (see ThreadComm::split()).
+ * 
+ *  Tasks are not handed to the scheduler directly.  Instead their frames are
+ *  put on a stack of pending tasks and the scheduler runs up to size()
+ *  runners that pop and run tasks until the stack is empty.  With the native
+ *  engine the runners are QueueRunners in the pool, at most size()-1 of
+ *  them, since a thread waiting on the queue runs its tasks too.  This way a thread blocked in
+ *  ThreadFuture::get() can pop and run pending tasks too (see help()) instead
+ *  of waiting on the whole task group.  The stack is LIFO so, as with TBB's
+ *  own deques, helping tends to pick up the most recently spawned (and hence
+ *  most closely related) work.  There is one stack per priority and pops
+ *  take from the highest priority stack that has a task.
+ * 
+ *  Whether a task is queued at all depends on how much work is already
+ *  queued (see Grains).  Inlined tasks never reach the scheduler; their
+ *  futures are ready when add_task() returns.
+ * 
+ *  Tasks run by their own future leave a stale frame behind.  The future
+ *  pops those right away (see drop_stale()) so they do not pile up.
+ */
 class ThreadQueue{
 private:
-    tbb::task_group Queue_;///< The actual queue
+    tbb::task_group Queue_;///< Where our runners go
+    tbb::spin_mutex PendingMutex_;///< Guards Pending_
+    ///Tasks not yet started, per priority
+    std::vector<TaskFrameBase*> Pending_[NPriorities];
+    ///Total size of Pending_, readable without lock
+    std::atomic<size_t> NPending_;
+    size_t NThreads_;///< Most threads our work runs on
+    std::atomic<size_t> NRunners_;///< Runners in Queue_ (or Pool_)
+    WorkStealingPool* Pool_;///< The native scheduler, NULL for TBB
+    ///True if we use the runners with Pool_, as we may not use all of it
+    bool Capped_;
+    size_t MaxRunners_;///< Most runners we will have at once
+    std::atomic<size_t> NLiveRunners_;///< QueueRunners in Pool_ not yet done
+    tbb::task_arena* Arena_;///< Where our TBB work runs, NULL for the default
+    CancelToken Token_;///< Once cancelled, our tasks are no longer run
+    std::atomic<size_t> NRunning_;///< Unfinished tasks (and continuations)
+    
+    friend struct TaskFrameBase;
+    friend struct QueueRunner;
+    
+    ///Removes the newest pending task of the highest priority, NULL if
+    ///there is none (if \p OnlyStale, only stale tasks are considered)
+    TaskFrameBase* pop(bool OnlyStale=false)
+    {
+        tbb::spin_mutex::scoped_lock Lock(PendingMutex_);
+        for(size_t P=NPriorities;P--;){
+            std::vector<TaskFrameBase*>& Stack=Pending_[P];
+            if(Stack.empty()||(OnlyStale && !Stack.back()->stale()))continue;
+            TaskFrameBase* Task=Stack.back();
+            Stack.pop_back();
+            NPending_.store(NPending_.load(std::memory_order_relaxed)-1,
+                            std::memory_order_relaxed);
+            return Task;
+        }
+        return nullptr;
+    }
+    
+    ///Pops and runs a pending task, returns false if there were none
+    bool run_one()
+    {
+        TaskFrameBase* Task=pop();
+        if(!Task)return false;
+        Task->execute();
+        return true;
+    }
+    
+    ///Takes a runner slot if one is free
+    bool add_runner()
+    {
+        size_t NRunners=NRunners_.load();
+        while(NRunners<MaxRunners_)
+            if(NRunners_.compare_exchange_weak(NRunners,NRunners+1))
+                return true;
+        return false;
+    }
+    
+    ///What the runners in Queue_ (or Pool_) do
+    void runner()
+    {
+        do{
+            while(run_one());
+            //Pairs with add_task() pushing a task and then calling add_runner
+            --NRunners_;
+            {
+                tbb::spin_mutex::scoped_lock Lock(PendingMutex_);
+                if(!NPending_.load(std::memory_order_relaxed))return;
+            }
+        }while(add_runner());
+    }
+    
+    ///Elements per block (leaf) of deterministic_reduce()'s tree
+    static const size_t ReduceBlockSize=2048;
+    
+    ///Subtrees of deterministic_reduce() with this few blocks are serial
+    static const size_t SerialBlocks=4;
+    
+    ///Reduces blocks [First,Last) of the N elements starting at \p Begin
+    template<typename fxn_type,typename const_iterator>
+    auto reduce_blocks(const fxn_type& Fxn,const_iterator Begin,size_t N,
+                       size_t First,size_t Last)
+        ->decltype(Fxn(Fxn(Begin),Fxn(Begin)))
+    {
+        using return_type=decltype(Fxn(Fxn(Begin),Fxn(Begin)));
+        using diff_type=
+            typename std::iterator_traits<const_iterator>::difference_type;
+        if(Last-First==1){
+            const_iterator i=Begin+static_cast<diff_type>(First*ReduceBlockSize);
+            const_iterator BlockEnd=Begin+static_cast<diff_type>(
+                std::min(N,Last*ReduceBlockSize));
+            return_type Sum=return_type();
+            for(;i!=BlockEnd;++i)Sum=Fxn(Sum,Fxn(i));
+            return Sum;
+        }
+        const size_t Mid=First+(Last-First)/2;
+        return_type Left,Right;
+        auto DoLeft=[&](){Left=reduce_blocks(Fxn,Begin,N,First,Mid);};
+        auto DoRight=[&](){Right=reduce_blocks(Fxn,Begin,N,Mid,Last);};
+        if(Last-First<=SerialBlocks){
+            DoLeft();
+            DoRight();
+        }
+        else tbb::parallel_invoke(DoLeft,DoRight);
+        return Fxn(Left,Right);
+    }
+    
+    ///Used by AFFINITY_PARTITIONER loops that don't bring their own
+    LoopAffinity Affinity_;
+    
+    ///Runs the loop with one of TBB's partitioners
+    template<typename index_type,typename fxn_type,typename partitioner_type>
+    void run_for(index_type Begin,index_type End,const fxn_type& Fxn,
+                 size_t Grain,partitioner_type&& Partitioner)
+    {
+        tbb::parallel_for(tbb::blocked_range<index_type>(Begin,End,Grain),
+            [&Fxn](const tbb::blocked_range<index_type>& Range){
+                for(index_type i=Range.begin();i!=Range.end();++i)Fxn(i);
+            },Partitioner);
+    }
+    
+    ///About how many bytes of results scan() works on at a time
+    static const size_t ScanBlockBytes=64*1024;
+    
+    ///Fewest blocks per thread scan() will make (for load balancing)
+    static const size_t ScanBlocksPerThread=4;
+    
+    ///Chunk buffers per thread stream_reduce() may have in flight
+    static const size_t StreamBuffersPerThread=2;
+    
+    ///Hash partitions per thread that group_reduce() merges in parallel
+    static const size_t GroupPartsPerThread=4;
+    
+    ///Queued tasks per thread past which GRAIN_AUTO tasks are run inline
+    static const size_t InlineDepth=4;
+    
+    ///True if a task of grain \p Grain should skip the scheduler
+    bool run_inline(Grains Grain)const
+    {
+        if(Grain==GRAIN_COARSE)return false;
+        const size_t NQueued=Pool_ && !Capped_?Pool_->nqueued():
+                             NPending_.load(std::memory_order_relaxed);
+        return NQueued>=NThreads_*(Grain==GRAIN_FINE?1:InlineDepth);
+    }
+    
+    ///Hands a frame to the scheduler
+    void submit(TaskFrameBase* Frame)
+    {
+        if(Pool_ && !Capped_)return Pool_->submit(Frame);
+        //Once pushed the frame may run, and be freed, at any time
+        const Priorities Priority=Frame->Priority_;
+        {
+            tbb::spin_mutex::scoped_lock Lock(PendingMutex_);
+            Pending_[Priority].push_back(Frame);
+            NPending_.store(NPending_.load(std::memory_order_relaxed)+1,
+                            std::memory_order_relaxed);
+        }
+        if(!add_runner())return;
+        if(!Pool_)return isolate([this](){Queue_.run([this](){runner();});});
+        ++NLiveRunners_;
+        QueueRunner* Runner=new QueueRunner(this);
+        Runner->Priority_=Priority;
+        Pool_->submit(Runner);
+    }
 public:    
-    ThreadQueue(size_t)
+    ThreadQueue(size_t NThreads,WorkStealingPool* Pool=nullptr,
+                tbb::task_arena* Arena=nullptr,CancelToken Token=CancelToken()):
+        NPending_(0),NThreads_(NThreads?NThreads:1),NRunners_(0),Pool_(Pool),
+        Capped_(Pool && NThreads_<Pool->size()),
+        MaxRunners_(Capped_?NThreads_-1:NThreads_),NLiveRunners_(0),
+        Arena_(Arena),Token_(Token),NRunning_(0)
     {}
     
+    ///Runners in the task group refer to us, so they must finish first
+    ~ThreadQueue()
+    {
+        wait();
+    }
+    
+    size_t size()const{return NThreads_;}///< Most threads our work runs on
+    
+    const CancelToken& token()const{return Token_;}///< Our cancellation flag
+    
+    ///Tasks not yet started won't be, their futures throw TaskCancelled
+    void cancel(){Token_.cancel();}
+    
+    bool cancelled()const{return Token_.cancelled();}///< True once cancelled
+    
+    /** \brief Calls \p Fxn in our arena, so any TBB work it starts is
+     *         limited to (and kept within) our threads
+     */
+    template<typename fxn_type>
+    auto isolate(const fxn_type& Fxn)->decltype(Fxn())
+    {
+        if(!Arena_)return Fxn();
+        return Arena_->execute(Fxn);
+    }
+    
+    ///Adds a task, LOW_PRIORITY tasks and tasks with a preferred \p Node
+    ///are never run inline (that would put them ahead of everything queued,
+    ///or on the wrong node)
     template<typename TaskType>
-    ThreadFuture<typename TaskType::return_type> add_task(const TaskType& Task)
+    ThreadFuture<typename TaskType::return_type> 
+    add_task(TaskType Task,Grains Grain=GRAIN_AUTO,
+             Priorities Priority=NORMAL_PRIORITY,size_t Node=AnyNode)
     {           
-        ThreadFuture<typename TaskType::return_type> 
-            Fut(std::move(Task.P_->get_future()),*this);
-
-        Queue_.run(Task);
+        auto Frame=new TaskFrame<TaskType>(std::move(Task),this);
+        Frame->Priority_=Priority;
+        Frame->Node_=Node;
+        if(Priority!=LOW_PRIORITY && Node==AnyNode && run_inline(Grain))
+            Frame->run_inline();
+        else{
+            ++NRunning_;
+            submit(Frame);
+        }
+        return ThreadFuture<typename TaskType::return_type>(Frame,*this);
+    }
+    
+    /** \brief Hands a frame that was made held (claimed) to the scheduler
+     * 
+     *  This is for frames whose release is up to someone else, e.g. the
+     *  nodes of a TaskGraph.
+     */
+    void release_held(TaskFrameBase* Frame)
+    {
+        ++NRunning_;
+        Frame->Claimed_.store(false);
+        submit(Frame);
+    }
+    
+    /** \brief Schedules the held frame \p Resume to run once \p Antecedent
+     *         is done
+     * 
+     *  Unlike add_continuation() nobody waits on \p Resume and it does not
+     *  take over a reference to \p Antecedent.
+     * 
+     *  \return False, after freeing \p Resume, if \p Antecedent was already
+     *          done
+     */
+    bool add_resume(TaskFrameBase* Antecedent,TaskFrameBase* Resume)
+    {
+        ++NRunning_;
+        Resume->release();//Give up the reference a future would have had
+        TaskFrameBase* Expected=nullptr;
+        if(Antecedent->Next_.compare_exchange_strong(Expected,Resume))
+            return true;
+        --NRunning_;
+        Resume->release();
+        return false;
+    }
+    
+    /** \brief Schedules \p Fxn to run on the result of \p Antecedent once
+     *         it is ready
+     * 
+     *  Takes over the caller's reference to \p Antecedent.  If the
+     *  antecedent is already done the continuation is scheduled right away.
+     *  The continuation has the antecedent's priority.
+     */
+    template<typename T,typename FxnType>
+    ThreadFuture<typename std::result_of<FxnType(T)>::type>
+    add_continuation(std::unique_ptr<ResultFrame<T>,FrameReleaser> Antecedent,
+                     FxnType&& Fxn)
+    {
+        using fxn_type=typename std::decay<FxnType>::type;
+        ++NRunning_;
+        ResultFrame<T>* Prior=Antecedent.get();
+        auto Frame=new ContinuationFrame<T,fxn_type>(std::move(Antecedent),
+                            fxn_type(std::forward<FxnType>(Fxn)),this);
+        Frame->Priority_=Prior->Priority_;
+        Frame->Node_=Prior->Node_;
+        ThreadFuture<typename std::result_of<FxnType(T)>::type> Fut(Frame,*this);
+        TaskFrameBase* Expected=nullptr;
+        if(!Prior->Next_.compare_exchange_strong(Expected,Frame)){
+            Frame->Claimed_.store(false);
+            submit(Frame);
+        }
         return Fut;
     }
     
@@ -85,12 +619,332 @@ public:
         return Task.MySum_;
     }
     
+    /** \brief Same as reduce(), but always combines in the same order
+     * 
+     *  The range is cut into blocks of ReduceBlockSize elements, whatever
+     *  the number of threads, each block is reduced left to right, and the
+     *  block results are combined by a balanced binary tree whose shape
+     *  only depends on the number of blocks.  Threads only decide who
+     *  computes which subtree, so the result is reproducible bit for bit.
+     */
+    template<typename TaskType,typename const_iterator>
+    typename TaskType::return_type deterministic_reduce(TaskType& Task,
+                                                        const_iterator Begin,
+                                                        const_iterator End)
+    {
+        const size_t N=static_cast<size_t>(End-Begin);
+        if(!N)return typename TaskType::return_type();
+        return reduce_blocks(Task.Fxn_,Begin,N,0,
+                             (N+ReduceBlockSize-1)/ReduceBlockSize);
+    }
+    
+    /** \brief Reduces the values \p Source produces, a chunk at a time
+     * 
+     *  The calling thread reads chunks of up to \p ChunkSize values into
+     *  buffers, and hands each full buffer to a task that reduces it (into
+     *  a per-thread partial result) and then gives the buffer back.  There
+     *  are at most StreamBuffersPerThread buffers per thread; if all of them
+     *  are in use the calling thread reduces the chunk it just read itself.
+     *  Hence memory use is bounded and reading never waits on reducing.
+     * 
+     *  \p Source is called as <code>bool Source(value_type&)</code> and
+     *  returns false once it is out of values.
+     */
+    template<typename return_type,typename value_type,typename fxn_type,
+             typename source_type>
+    return_type stream_reduce(const fxn_type& Fxn,source_type& Source,
+                              size_t ChunkSize)
+    {
+        using buffer_type=std::vector<value_type>;
+        const size_t NBuffers=StreamBuffersPerThread*NThreads_;
+        std::vector<buffer_type> Buffers(NBuffers+1);
+        std::vector<size_t> Free;
+        for(size_t i=1;i<=NBuffers;++i)Free.push_back(i);
+        tbb::spin_mutex FreeMutex;
+        tbb::enumerable_thread_specific<return_type> Partials;
+        tbb::task_group Reducers;
+        
+        auto reduce_buffer=[&](buffer_type& Buffer){
+            return_type Sum=return_type();
+            for(auto i=Buffer.cbegin();i!=Buffer.cend();++i)Sum=Fxn(Sum,Fxn(i));
+            return_type& Partial=Partials.local();
+            Partial=Fxn(Partial,Sum);
+            Buffer.clear();
+        };
+        
+        size_t Mine=0;//The buffer the calling thread is filling
+        for(bool More=true;More;){
+            buffer_type& Buffer=Buffers[Mine];
+            Buffer.reserve(ChunkSize);
+            value_type Value;
+            while(Buffer.size()<ChunkSize && (More=Source(Value)))
+                Buffer.push_back(std::move(Value));
+            if(Buffer.empty())break;
+            size_t Next=Mine;
+            {
+                tbb::spin_mutex::scoped_lock Lock(FreeMutex);
+                if(!Free.empty()){
+                    Next=Free.back();
+                    Free.pop_back();
+                }
+            }
+            if(Next==Mine){
+                reduce_buffer(Buffer);
+                continue;
+            }
+            Reducers.run([&,Mine](){
+                reduce_buffer(Buffers[Mine]);
+                tbb::spin_mutex::scoped_lock Lock(FreeMutex);
+                Free.push_back(Mine);
+            });
+            Mine=Next;
+        }
+        Reducers.wait();
+        return_type Result=return_type();
+        for(const return_type& Partial:Partials)Result=Fxn(Result,Partial);
+        return Result;
+    }
+    
+    ///Same as reduce(), but in chunks of at least \p Grain elements
+    template<typename TaskType,typename const_iterator>
+    typename TaskType::return_type reduce(TaskType& Task,
+                                          const_iterator Begin,
+                                          const_iterator End,
+                                          size_t Grain)
+    {
+        tbb::blocked_range<const_iterator> r(Begin,End,Grain);
+        tbb::parallel_reduce(r,Task);
+        return Task.MySum_;
+    }
+    
+    /** \brief Scans [Begin,End) into \p Out, returns the reduction of the
+     *         whole range
+     * 
+     *  Two passes over blocks of about ScanBlockBytes: the first reduces
+     *  each block, then (serially) the block results are turned into
+     *  offsets, and the second scans each block starting from its offset.
+     *  Both passes share an affinity partitioner, so a block tends to be
+     *  scanned by the thread that just reduced it, while it is still in
+     *  that thread's cache.
+     */
+    template<typename return_type,typename fxn_type,typename in_itr,
+             typename out_itr>
+    return_type scan(const fxn_type& Fxn,in_itr Begin,in_itr End,out_itr Out,
+                     bool Inclusive)
+    {
+        using diff_type=typename std::iterator_traits<in_itr>::difference_type;
+        const size_t N=static_cast<size_t>(End-Begin);
+        if(!N)return return_type();
+        const size_t MostPerBlock=
+            std::max<size_t>(1,ScanBlockBytes/sizeof(return_type));
+        const size_t FewestBlocks=NThreads_*ScanBlocksPerThread;
+        const size_t BlockSize=std::min(MostPerBlock,
+                                        (N+FewestBlocks-1)/FewestBlocks);
+        const size_t NBlocks=(N+BlockSize-1)/BlockSize;
+        std::vector<return_type> Offsets(NBlocks);
+        tbb::affinity_partitioner Affinity;
+        
+        tbb::parallel_for(tbb::blocked_range<size_t>(0,NBlocks),
+            [&](const tbb::blocked_range<size_t>& Blocks){
+                for(size_t Block=Blocks.begin();Block!=Blocks.end();++Block){
+                    const size_t Last=std::min(N,(Block+1)*BlockSize);
+                    return_type Sum=return_type();
+                    for(size_t i=Block*BlockSize;i<Last;++i)
+                        Sum=Fxn(Sum,Fxn(Begin+static_cast<diff_type>(i)));
+                    Offsets[Block]=Sum;
+                }
+            },Affinity);
+        
+        return_type Total=return_type();
+        for(return_type& Offset:Offsets){
+            return_type Next=Fxn(Total,Offset);
+            Offset=Total;
+            Total=Next;
+        }
+        
+        tbb::parallel_for(tbb::blocked_range<size_t>(0,NBlocks),
+            [&](const tbb::blocked_range<size_t>& Blocks){
+                for(size_t Block=Blocks.begin();Block!=Blocks.end();++Block){
+                    const size_t Last=std::min(N,(Block+1)*BlockSize);
+                    return_type Running=Offsets[Block];
+                    for(size_t i=Block*BlockSize;i<Last;++i){
+                        const diff_type Index=static_cast<diff_type>(i);
+                        //Read before writing, so Out may be Begin
+                        return_type Value=Fxn(Begin+Index);
+                        if(!Inclusive)Out[Index]=Running;
+                        Running=Fxn(Running,Value);
+                        if(Inclusive)Out[Index]=Running;
+                    }
+                }
+            },Affinity);
+        return Total;
+    }
+    
+    /** \brief Reduces [Begin,End) separately for each key
+     * 
+     *  Each thread accumulates into its own GroupTable, so there is no
+     *  locking and no allocation per element.  The tables are partitioned by
+     *  hash the same way, so the merge runs in parallel over partitions.
+     */
+    template<typename key_type,typename value_type,typename fxn_type,
+             typename itr_type>
+    std::vector<std::pair<key_type,value_type>>
+    group_reduce(const fxn_type& Fxn,itr_type Begin,itr_type End)
+    {
+        using table_type=GroupTable<key_type,value_type>;
+        size_t NParts=1;
+        while(NParts<GroupPartsPerThread*NThreads_)NParts*=2;
+        tbb::enumerable_thread_specific<table_type> Tables((table_type(NParts)));
+        tbb::parallel_for(tbb::blocked_range<itr_type>(Begin,End),
+            [&](const tbb::blocked_range<itr_type>& Range){
+                table_type& Table=Tables.local();
+                for(itr_type i=Range.begin();i!=Range.end();++i){
+                    std::pair<key_type,value_type> KeyValue=Fxn(i);
+                    Table.add(std::move(KeyValue.first),
+                              std::move(KeyValue.second),Fxn);
+                }
+            });
+        
+        std::vector<table_type*> Locals;
+        for(table_type& Table:Tables)Locals.push_back(&Table);
+        if(Locals.empty())return std::vector<std::pair<key_type,value_type>>();
+        std::vector<size_t> Offsets(NParts+1,0);
+        tbb::parallel_for(size_t(0),NParts,[&](size_t Part){
+            OpenHashTable<key_type,value_type>& Into=Locals[0]->part(Part);
+            for(size_t i=1;i<Locals.size();++i)
+                Into.merge(Locals[i]->part(Part),Fxn);
+            Offsets[Part+1]=Into.size();
+        });
+        std::partial_sum(Offsets.begin(),Offsets.end(),Offsets.begin());
+        std::vector<std::pair<key_type,value_type>> Result(Offsets.back());
+        tbb::parallel_for(size_t(0),NParts,[&](size_t Part){
+            Locals[0]->part(Part).move_to(Result.begin()+
+                static_cast<std::ptrdiff_t>(Offsets[Part]));
+        });
+        return Result;
+    }
+    
+    /** \brief group_reduce for keys that are the integers [0,NKeys)
+     * 
+     *  Each thread accumulates into a plain array instead of a hash table,
+     *  and the arrays are merged in parallel over blocks of keys.
+     */
+    template<typename value_type,typename fxn_type,typename itr_type>
+    std::vector<value_type> dense_group_reduce(const fxn_type& Fxn,
+                                               itr_type Begin,itr_type End,
+                                               size_t NKeys)
+    {
+        using table_type=std::vector<value_type>;
+        tbb::enumerable_thread_specific<table_type> Tables((table_type(NKeys)));
+        tbb::parallel_for(tbb::blocked_range<itr_type>(Begin,End),
+            [&](const tbb::blocked_range<itr_type>& Range){
+                table_type& Table=Tables.local();
+                for(itr_type i=Range.begin();i!=Range.end();++i){
+                    auto KeyValue=Fxn(i);
+                    const size_t Key=static_cast<size_t>(KeyValue.first);
+                    PARALLEL_ASSERT(Key<NKeys,"Key is out of range");
+                    Table[Key]=Fxn(std::move(Table[Key]),
+                                   std::move(KeyValue.second));
+                }
+            });
+        
+        table_type Result(NKeys);
+        tbb::parallel_for(tbb::blocked_range<size_t>(0,NKeys),
+            [&](const tbb::blocked_range<size_t>& Keys){
+                for(table_type& Table:Tables)
+                    for(size_t Key=Keys.begin();Key!=Keys.end();++Key)
+                        Result[Key]=Fxn(std::move(Result[Key]),
+                                        std::move(Table[Key]));
+            });
+        return Result;
+    }
+    
+    ///Calls \p Fxn on each index (or iterator) in [Begin,End) in parallel
+    template<typename index_type,typename fxn_type>
+    void parallel_for(index_type Begin,index_type End,const fxn_type& Fxn,
+                      size_t Grain,Partitioners Partitioner)
+    {
+        switch(Partitioner){
+            case(SIMPLE_PARTITIONER):
+                return run_for(Begin,End,Fxn,Grain,tbb::simple_partitioner());
+            case(AUTO_PARTITIONER):
+                return run_for(Begin,End,Fxn,Grain,tbb::auto_partitioner());
+            case(AFFINITY_PARTITIONER):
+                return run_for(Begin,End,Fxn,Grain,Affinity_.Partitioner_);
+        }
+    }
+    
+    ///Same as above, but with the chunk to thread mapping of \p Affinity
+    template<typename index_type,typename fxn_type>
+    void parallel_for(index_type Begin,index_type End,const fxn_type& Fxn,
+                      size_t Grain,LoopAffinity& Affinity)
+    {
+        run_for(Begin,End,Fxn,Grain,Affinity.Partitioner_);
+    }
+    
+    ///Runs a pending task if there is one, returns false if there was none
+    bool help()
+    {
+        return Pool_ && !Capped_?Pool_->run_one():run_one();
+    }
+    
+    ///Throws away the already run tasks at the top of the calling thread's
+    ///stack/deque
+    void drop_stale()
+    {
+        if(Pool_ && !Capped_)return Pool_->drop_stale();
+        while(TaskFrameBase* Task=pop(true))Task->execute();
+    }
+    
+    ///Waits for every task ever added to this queue
     void wait()
     {
-        Queue_.wait();
+        if(!Pool_)isolate([this](){Queue_.wait();});
+        while(NRunning_.load())
+            if(!help())std::this_thread::yield();
+        //Our QueueRunners refer to us, and one may still be in our deque
+        while(NLiveRunners_.load())
+            if(!Pool_->run_one())std::this_thread::yield();
     }
 };
 
+void QueueRunner::execute()
+{
+    ThreadQueue* Queue=Queue_;
+    delete this;
+    Queue->runner();
+    --Queue->NLiveRunners_;//The queue may be gone after this, don't touch it
+}
+
+void TaskFrameBase::run_inline()
+{
+    Claimed_.store(true,std::memory_order_relaxed);
+    NRefs_.store(1,std::memory_order_relaxed);
+    if(Queue_->cancelled())abandon();
+    else compute();
+    Next_.store(this,std::memory_order_relaxed);
+}
+
+bool TaskFrameBase::try_run()
+{
+    if(stale() || Claimed_.exchange(true))return false;
+    if(Queue_->Pool_)Queue_->Pool_->count_waited_run();
+    if(Queue_->cancelled())abandon();
+    else compute();
+    if(!Deferred_)finish();
+    return true;
+}
+
+void TaskFrameBase::finish()
+{
+    //Whoever sets Next_ second schedules the continuation
+    TaskFrameBase* Next=Next_.exchange(this);
+    if(Next){
+        Next->Claimed_.store(false);
+        Queue_->submit(Next);
+    }
+    --Queue_->NRunning_;//The queue may be gone after this, don't touch it
+}
+
 }//End namespace LIbTaskForce
 #endif /* LIBTASKFORCE_GUARD_THREADQUEUE_HPP */
-
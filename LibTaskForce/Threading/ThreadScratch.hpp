@@ -0,0 +1,159 @@
+/*  
+ *   LibTaskForce: An open-source library for task-based parallelism
+ * 
+ *   Copyright (C) 2016 Ryan M. Richard
+ * 
+ *   This file is part of LibTaskForce.
+ *
+ *   LibTaskForce is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LibTaskForce is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LibTaskForce.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+/** \file ThreadScratch.hpp
+ *  \brief Reusable per-thread scratch objects for tasks
+ *  \author Ryan M. Richard
+ *  \version 1.0
+ *  \date October 17, 2026
+ */
+
+#ifndef LIBTASKFORCE_GUARD_THREADSCRATCH_HPP
+#define LIBTASKFORCE_GUARD_THREADSCRATCH_HPP
+
+#include <memory>
+#include <utility>
+#include <vector>
+#include <tbb/enumerable_thread_specific.h>
+
+namespace LibTaskForce {
+
+/** \brief Scratch objects (workspaces, accumulators, ...) that tasks lease
+ *         instead of making their own
+ * 
+ *  Like tbb::enumerable_thread_specific, of which it is a wrapper, each
+ *  thread has its own objects, made (as copies of an exemplar) the first
+ *  time the thread needs one and reused by every later task it runs.  So a
+ *  workspace is allocated once per thread rather than once per task:
+ *  \code
+ *  std::unique_ptr<ThreadScratch<Matrix_t>> Work=
+ *      Comm.make_scratch(Matrix_t(BlockSize));
+ *  ...
+ *  //In a task
+ *  ThreadScratch<Matrix_t>::Lease Buffer=Work->lease();
+ *  Buffer->assign(BlockSize,0.0);
+ *  \endcode
+ * 
+ *  Unlike enumerable_thread_specific::local(), a thread can hold several
+ *  leases at once.  This matters because a thread waiting on a future runs
+ *  other tasks in the meantime (see ThreadFuture::get()), and those may
+ *  lease an object while the waiting task still holds one.  Each lease gets
+ *  its own object, so a thread ends up with as many objects as it ever
+ *  leased at once.
+ * 
+ *  A lease must be released (destroyed) on the thread that took it, so a
+ *  coroutine (see CoTask) must not hold one across a co_await.  After the
+ *  tasks are done, combine() or combine_each() visit the objects of all
+ *  threads, e.g. to sum per-thread accumulators.
+ */
+template<typename T>
+class ThreadScratch{
+private:
+    ///One thread's objects
+    struct Stash{
+        std::vector<std::unique_ptr<T>> Objects_;///< All the thread made
+        std::vector<T*> Free_;///< Those not leased right now
+    };
+    
+    T Exemplar_;///< New objects are copies of this
+    tbb::enumerable_thread_specific<Stash> Stashes_;///< One per thread
+    
+public:
+    ///A scratch object the holder may use until the lease is destroyed
+    class Lease{
+    private:
+        Stash* Stash_;///< Where the object goes back to
+        T* Object_;///< The object, NULL once moved from
+        friend class ThreadScratch;
+        Lease(Stash* Owner,T* Object):Stash_(Owner),Object_(Object){}
+    public:
+        Lease(Lease&& Other):
+            Stash_(Other.Stash_),Object_(std::exchange(Other.Object_,nullptr))
+        {}
+        Lease(const Lease&)=delete;
+        Lease& operator=(const Lease&)=delete;
+        Lease& operator=(Lease&&)=delete;
+        
+        ///Returns the object to the thread's free objects
+        ~Lease(){if(Object_)Stash_->Free_.push_back(Object_);}
+        
+        T& operator*()const{return *Object_;}
+        T* operator->()const{return Object_;}
+    };
+    
+    ///Makes a (still empty) set of scratch objects, copies of \p Exemplar
+    explicit ThreadScratch(const T& Exemplar=T()):Exemplar_(Exemplar){}
+    
+    ///Hands the calling thread one of its free objects, making one if needed
+    Lease lease()
+    {
+        Stash& Mine=Stashes_.local();
+        if(Mine.Free_.empty()){
+            Mine.Objects_.emplace_back(new T(Exemplar_));
+            //So giving objects back never allocates
+            Mine.Free_.reserve(Mine.Objects_.size());
+            return Lease(&Mine,Mine.Objects_.back().get());
+        }
+        T* Object=Mine.Free_.back();
+        Mine.Free_.pop_back();
+        return Lease(&Mine,Object);
+    }
+    
+    ///The number of objects made so far, over all threads
+    size_t size()const
+    {
+        size_t NObjects=0;
+        for(const Stash& Si:Stashes_)NObjects+=Si.Objects_.size();
+        return NObjects;
+    }
+    
+    ///Calls \p Fxn on every object; not safe while tasks hold leases
+    template<typename FxnType>
+    void combine_each(FxnType&& Fxn)
+    {
+        for(Stash& Si:Stashes_)
+            for(std::unique_ptr<T>& Object:Si.Objects_)Fxn(*Object);
+    }
+    
+    /** \brief Reduces all objects with the binary functor \p Fxn
+     * 
+     *  Not safe while tasks hold leases.
+     * 
+     *  \return The combined value, a copy of the exemplar if no objects were
+     *          ever made
+     */
+    template<typename FxnType>
+    T combine(FxnType&& Fxn)
+    {
+        std::unique_ptr<T> Result;
+        combine_each([&](const T& Object){
+            if(!Result)Result.reset(new T(Object));
+            else *Result=Fxn(*Result,Object);
+        });
+        return Result?std::move(*Result):Exemplar_;
+    }
+    
+    ///Frees all objects; not safe while tasks hold leases
+    void clear(){Stashes_.clear();}
+};
+
+}//End namespace LibTaskForce
+#endif /* LIBTASKFORCE_GUARD_THREADSCRATCH_HPP */
@@ -29,7 +29,7 @@
 #ifndef LIBTASKFORCE_GUARD_THREADTASK_HPP
 #define LIBTASKFORCE_GUARD_THREADTASK_HPP
 
-#include <future>
+#include <exception>
 #include <iostream>
 #include "LibTaskForce/General/GeneralTask.hpp"
 
@@ -38,21 +38,34 @@ namespace LibTaskForce {
 ///A wrapper around a functor for use in ThreadComm::add_task
 template<typename T,typename functor_type,typename comm_type>
 struct ThreadTask :public Task<T,functor_type,comm_type> {
-    using promise_type = std::promise<T>;
     using return_type=T;
     using base_t=Task<T,functor_type,comm_type>;
     
-    std::shared_ptr<promise_type> P_;///<Eventually will be the result
-           
     ThreadTask(functor_type&& F, comm_type& Cm) :
-        base_t(std::forward<functor_type>(F),Cm),
-        P_(std::make_shared<promise_type>())
+        base_t(std::forward<functor_type>(F),Cm)
     {}
     
+    ThreadTask(ThreadTask&&)=default;
+    
+    /** \brief Calls the functor with the comm the task was added to
+     * 
+     *  Unlike the base class we do not split off a new comm for every task.
+     *  Futures only wait on their own task, so children can share the
+     *  parent's queue, and handing over a reference costs nothing.
+     */
     T operator()()const{
-        T value=base_t::operator()();
-        P_->set_value(value);
-        return value;
+        return this->Fxn_(this->CurrentComm_);
+    }
+    
+    ///Runs the task putting the result (or exception) in \p Result
+    template<typename slot_type>
+    void run(slot_type& Result){
+        try{
+            Result.set_value((*this)());
+        }
+        catch(...){
+            Result.set_exception(std::current_exception());
+        }
     }
 };
 
@@ -91,6 +104,49 @@ struct ReduceTask {
     }
 };
 
+/** \brief Like ReduceTask, but the user's functor reduces whole chunks
+ * 
+ *  Because the functor sees an entire chunk at once its loop can be
+ *  vectorized (see ReduceKernels.hpp), which is impossible when it is
+ *  called one element at a time.  The first chunk's result seeds the
+ *  partial result, so no identity value is needed (min and max have none
+ *  that default construction would give).
+ */
+template<typename T,typename functor_type>
+struct ChunkReduceTask {
+    using return_type=T;///< The type of the final answer
+    using MyType=ChunkReduceTask<return_type,functor_type>;///< The type of this
+    functor_type Fxn_;///<The functor that will be used for reduction
+    return_type MySum_;///< Eventually the result
+    bool Empty_;///< True until MySum_ holds a partial result
+    
+    ChunkReduceTask(const functor_type& Fxn) :
+        Fxn_(Fxn),MySum_(),Empty_(true)
+    {}
+    
+    ///The split constructor for tbb
+    ChunkReduceTask(MyType& Other,tbb::split):
+        Fxn_(Other.Fxn_),MySum_(),Empty_(true)
+    {}
+    
+    ///The call tbb will use
+    template<typename const_iterator>
+    void operator()(const tbb::blocked_range<const_iterator>& range)
+    {
+        return_type Chunk=Fxn_(range.begin(),range.end());
+        MySum_=Empty_?std::move(Chunk):Fxn_(std::move(MySum_),std::move(Chunk));
+        Empty_=false;
+    }
+    
+    ///Used by tbb for joining results
+    void join(MyType& Other)
+    {
+        if(Other.Empty_)return;
+        MySum_=Empty_?std::move(Other.MySum_):
+                      Fxn_(std::move(MySum_),std::move(Other.MySum_));
+        Empty_=false;
+    }
+};
 
 }//End namespace LIbTaskForce
 #endif /* LIBTASKFORCE_GUARD_THREADTASK_HPP */
@@ -0,0 +1,348 @@
+/*  
+ *   LibTaskForce: An open-source library for task-based parallelism
+ * 
+ *   Copyright (C) 2016 Ryan M. Richard
+ * 
+ *   This file is part of LibTaskForce.
+ *
+ *   LibTaskForce is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LibTaskForce is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LibTaskForce.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+#include <sstream>
+#include "LibTaskForce/Threading/WorkStealingPool.hpp"
+
+namespace LibTaskForce{
+
+///The pool and slot index of the calling thread (if it has one)
+///@{
+static thread_local const WorkStealingPool* MyPool=nullptr;
+static thread_local size_t MySlot=0;
+///@}
+
+///Random number state for threads stealing without a slot
+static thread_local unsigned ExternalSeed=0x9E3779B9u;
+
+///How many times an IDLE_SLEEP worker looks for work before it goes to sleep
+static const size_t NSpins=64;
+
+///IDLE_SPIN workers yield once every this many polls, in case a thread
+///that would submit work is waiting for their CPU
+static const size_t NPollsPerYield=128;
+
+///Tells the CPU we are in a spin loop
+inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+///Xorshift generator used to pick victims
+inline unsigned next_random(unsigned& Seed)
+{
+    Seed^=Seed<<13;
+    Seed^=Seed>>17;
+    Seed^=Seed<<5;
+    return Seed;
+}
+
+constexpr std::chrono::milliseconds WorkStealingPool::WarmUpTime;
+
+WorkStealingPool::WorkStealingPool(size_t NThreads,const NumaTopology* Topology,
+                                   size_t SpreadOffset):
+    Topology_(Topology),SpreadOffset_(SpreadOffset),NSleeping_(0),Stop_(false),IdlePolicy_(IDLE_SLEEP),
+    SpinMicroseconds_(0),WarmUps_(0)
+{
+    for(std::atomic<size_t>& NQueued:NQueued_)NQueued.store(0);
+    if(!NThreads)NThreads=1;
+    if(Topology_ && Topology_->size()>1)
+        for(size_t Node=0;Node<Topology_->size();++Node)
+            NodeQueues_.emplace_back(new NodeQueue);
+    for(size_t i=0;i<NThreads;++i){
+        //Worker i will be pinned to spread_cpu(SpreadOffset_+i), we stay
+        //where we are
+        size_t Node=!Topology_?0:(i?Topology_->node_of(
+                                      Topology_->spread_cpu(SpreadOffset_+i)):
+                                    Topology_->current_node());
+        Slots_.emplace_back(new Slot(2654435761u*(unsigned)(i+1),
+                                     Node==AnyNode?0:Node));
+    }
+    if(!MyPool){
+        MyPool=this;
+        MySlot=0;
+    }
+    for(size_t i=1;i<NThreads;++i)
+        Slots_[i]->Thread_=std::thread(&WorkStealingPool::worker,this,i);
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> Lock(SleepMutex_);
+        Stop_=true;
+    }
+    Wake_.notify_all();
+    for(auto& Si:Slots_)
+        if(Si->Thread_.joinable())Si->Thread_.join();
+    if(MyPool==this)MyPool=nullptr;
+}
+
+WorkStealingPool::Slot* WorkStealingPool::my_slot()const
+{
+    return MyPool==this?Slots_[MySlot].get():nullptr;
+}
+
+size_t WorkStealingPool::nqueued()const
+{
+    size_t NQueued=0;
+    for(const std::atomic<size_t>& Ni:NQueued_)
+        NQueued+=Ni.load();
+    return NQueued;
+}
+
+PoolTask* WorkStealingPool::NodeQueue::pop(size_t P)
+{
+    if(!NTasks_.load(std::memory_order_relaxed))return nullptr;
+    std::lock_guard<std::mutex> Lock(Mutex_);
+    if(Tasks_[P].empty())return nullptr;
+    PoolTask* Task=Tasks_[P].front();
+    Tasks_[P].pop_front();
+    --NTasks_;
+    return Task;
+}
+
+void WorkStealingPool::submit(PoolTask* Task)
+{
+    const size_t P=Task->Priority_;
+    const size_t Node=Task->Node_;
+    Slot* Me=my_slot();
+    //Counted before it is published, so a thief's decrement can't come first
+    //and wrap the count around.  Pairs with the worker's increment of
+    //NSleeping_ and check of NQueued_.
+    ++NQueued_[P];
+    if(Node<NodeQueues_.size() && !(Me && Me->Node_==Node)){
+        NodeQueue& Queue=*NodeQueues_[Node];
+        std::lock_guard<std::mutex> Lock(Queue.Mutex_);
+        Queue.Tasks_[P].push_back(Task);
+        ++Queue.NTasks_;
+    }
+    else if(Me)Me->Deques_[P].push(Task);
+    else{
+        std::lock_guard<std::mutex> Lock(InjectMutex_);
+        Injected_[P].push_back(Task);
+    }
+    if(NSleeping_.load()){
+        std::lock_guard<std::mutex> Lock(SleepMutex_);
+        Wake_.notify_one();
+    }
+}
+
+PoolTask* WorkStealingPool::steal(Slot* Me,size_t P)
+{
+    const size_t NSlots=Slots_.size();
+    unsigned& Seed=Me?Me->Seed_:ExternalSeed;
+    const size_t Start=next_random(Seed)%NSlots;
+    PoolTask* Task=nullptr;
+    //With several nodes the first pass only visits our node's slots
+    const size_t NPasses=(Me && !NodeQueues_.empty())?2:1;
+    for(size_t Pass=0;Pass<NPasses;++Pass)
+        for(size_t i=0;i<NSlots;++i){
+            Slot* Victim=Slots_[(Start+i)%NSlots].get();
+            if(Victim==Me)continue;
+            if(NPasses==2 && (Victim->Node_==Me->Node_)!=(Pass==0))continue;
+            if(Victim->Deques_[P].steal(Task))return Task;
+        }
+    return nullptr;
+}
+
+PoolTask* WorkStealingPool::find_task(Slot* Me,bool& Stolen)
+{
+    PoolTask* Task=nullptr;
+    Stolen=false;
+    for(size_t P=NPriorities;P--;){
+        if(!NQueued_[P].load(std::memory_order_relaxed))continue;
+        Stolen=false;
+        if(Me && Me->Deques_[P].pop(Task))return Task;
+        if(Me && Me->Node_<NodeQueues_.size() &&
+           (Task=NodeQueues_[Me->Node_]->pop(P)))return Task;
+        {
+            std::lock_guard<std::mutex> Lock(InjectMutex_);
+            if(!Injected_[P].empty()){
+                Task=Injected_[P].front();
+                Injected_[P].pop_front();
+                return Task;
+            }
+        }
+        Stolen=true;
+        if((Task=steal(Me,P)))return Task;
+        for(std::unique_ptr<NodeQueue>& Queue:NodeQueues_)
+            if((Task=Queue->pop(P)))return Task;
+    }
+    return nullptr;
+}
+
+void WorkStealingPool::run(PoolTask* Task,Slot* Me,bool Stolen)
+{
+    --NQueued_[Task->Priority_];
+    //A stale task was already run (and counted) by whoever waited on it
+    if(Me && !Task->stale()){
+        Me->NRun_.fetch_add(1,std::memory_order_relaxed);
+        if(Stolen)Me->NStolen_.fetch_add(1,std::memory_order_relaxed);
+    }
+    Task->execute();
+}
+
+bool WorkStealingPool::run_one()
+{
+    Slot* Me=my_slot();
+    bool Stolen;
+    PoolTask* Task=find_task(Me,Stolen);
+    if(!Task)return false;
+    run(Task,Me,Stolen);
+    return true;
+}
+
+void WorkStealingPool::drop_stale()
+{
+    Slot* Me=my_slot();
+    if(!Me)return;
+    PoolTask* Task=nullptr;
+    for(size_t P=0;P<NPriorities;++P){
+        if(!NQueued_[P].load(std::memory_order_relaxed))continue;
+        while(Me->Deques_[P].pop(Task)){
+            if(!Task->stale()){
+                Me->Deques_[P].push(Task);
+                break;
+            }
+            --NQueued_[P];
+            Task->execute();
+        }
+    }
+}
+
+void WorkStealingPool::set_idle_policy(IdlePolicies Policy,
+                                       std::chrono::microseconds SpinTime)
+{
+    SpinMicroseconds_.store(static_cast<size_t>(SpinTime.count()));
+    IdlePolicy_.store(Policy);
+    //Workers sleeping under the old policy start over with the new one
+    std::lock_guard<std::mutex> Lock(SleepMutex_);
+    Wake_.notify_all();
+}
+
+void WorkStealingPool::touch_stack()
+{
+    volatile char Stack[StackTouchBytes];
+    for(size_t i=0;i<StackTouchBytes;i+=512)Stack[i]=0;
+    static_cast<void>(Stack);
+}
+
+bool WorkStealingPool::warm_up()
+{
+    const std::chrono::steady_clock::time_point Deadline=
+        std::chrono::steady_clock::now()+WarmUpTime;
+    const size_t WarmUp=++WarmUps_;
+    {
+        std::lock_guard<std::mutex> Lock(SleepMutex_);
+        Wake_.notify_all();
+    }
+    touch_stack();
+    const Slot* Me=my_slot();
+    for(size_t i=1;i<Slots_.size();++i){
+        if(Slots_[i].get()==Me)continue;
+        while(Slots_[i]->WarmedUp_.load()<WarmUp){
+            if(std::chrono::steady_clock::now()>=Deadline)return false;
+            std::this_thread::yield();
+        }
+    }
+    return true;
+}
+
+bool WorkStealingPool::keep_looking(size_t NIdle,
+    std::chrono::steady_clock::time_point IdleSince)const
+{
+    switch(IdlePolicy_.load(std::memory_order_relaxed)){
+        case IDLE_YIELD:
+            std::this_thread::yield();
+            return true;
+        case IDLE_SPIN:
+            if(std::chrono::steady_clock::now()-IdleSince>=std::chrono::microseconds(
+                   SpinMicroseconds_.load(std::memory_order_relaxed)))
+                return false;
+            if(NIdle%NPollsPerYield)cpu_relax();
+            else std::this_thread::yield();
+            return true;
+        default:
+            if(NIdle>=NSpins)return false;
+            std::this_thread::yield();
+            return true;
+    }
+}
+
+void WorkStealingPool::worker(size_t i)
+{
+    MyPool=this;
+    MySlot=i;
+    if(Topology_)
+        NumaTopology::pin_thread(Topology_->spread_cpu(SpreadOffset_+i));
+    Slot* Me=Slots_[i].get();
+    size_t NIdle=0;
+    std::chrono::steady_clock::time_point IdleSince;
+    while(!Stop_.load(std::memory_order_relaxed)){
+        bool Stolen;
+        PoolTask* Task=find_task(Me,Stolen);
+        if(Task){
+            run(Task,Me,Stolen);
+            NIdle=0;
+            continue;
+        }
+        const size_t WarmUp=WarmUps_.load();
+        if(Me->WarmedUp_.load(std::memory_order_relaxed)!=WarmUp){
+            touch_stack();
+            Me->WarmedUp_.store(WarmUp);
+            NIdle=0;
+        }
+        if(!NIdle++)IdleSince=std::chrono::steady_clock::now();
+        if(keep_looking(NIdle,IdleSince))continue;
+        std::unique_lock<std::mutex> Lock(SleepMutex_);
+        ++NSleeping_;
+        const IdlePolicies Policy=IdlePolicy_.load();
+        while(!nqueued() && !Stop_ && WarmUps_.load()==WarmUp &&
+              IdlePolicy_.load()==Policy)
+            Wake_.wait(Lock);
+        --NSleeping_;
+        NIdle=0;
+    }
+    MyPool=nullptr;
+}
+
+void WorkStealingPool::count_waited_run()
+{
+    Slot* Me=my_slot();
+    if(Me)Me->NWaited_.fetch_add(1,std::memory_order_relaxed);
+}
+
+std::string WorkStealingPool::print()const
+{
+    std::stringstream ss;
+    ss<<"Work-stealing pool with "<<size()<<" threads"<<std::endl;
+    for(size_t i=0;i<Slots_.size();++i)
+        ss<<"  Thread "<<i<<" (node "<<Slots_[i]->Node_<<"): ran "
+          <<Slots_[i]->NRun_<<" tasks, "<<Slots_[i]->NStolen_
+          <<" of them stolen, and "<<Slots_[i]->NWaited_
+          <<" while waiting on them"<<std::endl;
+    return ss.str();
+}
+
+}//End namespace
@@ -0,0 +1,261 @@
+/*  
+ *   LibTaskForce: An open-source library for task-based parallelism
+ * 
+ *   Copyright (C) 2016 Ryan M. Richard
+ * 
+ *   This file is part of LibTaskForce.
+ *
+ *   LibTaskForce is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LibTaskForce is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LibTaskForce.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+/** \file WorkStealingPool.hpp
+ *  \brief LibTaskForce's own work-stealing thread pool
+ *  \author Ryan M. Richard
+ *  \version 1.0
+ *  \date October 17, 2026
+ */
+
+#ifndef LIBTASKFORCE_GUARD_WORKSTEALINGPOOL_HPP
+#define LIBTASKFORCE_GUARD_WORKSTEALINGPOOL_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "LibTaskForce/Threading/ChaseLevDeque.hpp"
+#include "LibTaskForce/Threading/NumaTopology.hpp"
+
+namespace LibTaskForce {
+
+/** \brief How urgent a task is
+ * 
+ *  Schedulers take the highest priority task they can find, both from their
+ *  own queues and when stealing.  Priorities do not preempt running tasks.
+ */
+enum Priorities {
+    LOW_PRIORITY,   ///< Background work, run when nothing else is queued
+    NORMAL_PRIORITY,///< The default
+    HIGH_PRIORITY   ///< Latency-critical work, e.g. on the critical path
+};
+
+///The number of Priorities
+static const size_t NPriorities=HIGH_PRIORITY+1;
+
+/** \brief What a worker does while it can't find work
+ * 
+ *  Sleeping workers cost nothing but take a while to wake up, which the first
+ *  tasks after an idle gap pay for.  Polling workers pick those up right
+ *  away but burn their CPU meanwhile.
+ */
+enum IdlePolicies {
+    IDLE_SLEEP,///< Look for work a few times, then sleep (the default)
+    IDLE_SPIN, ///< Poll for work for a set time, rarely yielding, then sleep
+    IDLE_YIELD ///< Poll for work, yielding in between, and never sleep
+};
+
+///A unit of work for the WorkStealingPool
+struct PoolTask{
+    Priorities Priority_=NORMAL_PRIORITY;///< Which queues the task goes in
+    size_t Node_=AnyNode;///< The NUMA node the task would like to run on
+    
+    ///Runs the task and then releases it (the pool never frees tasks)
+    virtual void execute()=0;
+    
+    ///True if the task's work was already done elsewhere
+    virtual bool stale()const{return false;}
+    virtual ~PoolTask()=default;
+};
+
+/** \brief A thread pool built around per-thread work-stealing deques
+ * 
+ *  This is the alternative to TBB that ThreadEnv uses when asked for the
+ *  NATIVE_ENGINE.  Owning the scheduler means we control, and can report on,
+ *  how work moves between threads.
+ * 
+ *  A pool of size N has N slots, each with a ChaseLevDeque.  Slot 0 belongs
+ *  to the thread that made the pool (like TBB's master thread) and the other
+ *  N-1 slots belong to worker threads the pool starts.  A thread with a slot
+ *  pushes new tasks onto, and pops tasks from, the bottom of its own deque.
+ *  This makes local execution LIFO (depth-first, cache-friendly).  When its
+ *  deque is empty it steals from the top of the deque of a randomly chosen
+ *  victim, so stolen work is FIFO (the oldest, usually biggest, tasks).
+ *  Threads without a slot submit to a mutex-protected injection queue that
+ *  is checked before stealing.
+ * 
+ *  Each slot (and the injection queue) actually has one deque per priority.
+ *  Threads look for work a priority at a time, highest first: their own
+ *  deque, then the injection queue, then steals.  Per-priority counts of
+ *  queued tasks let them skip the (usually empty) levels quickly.
+ * 
+ *  Given a NumaTopology, the workers are pinned to CPUs spread over the
+ *  nodes (the calling thread is left alone, it is the user's) and each slot
+ *  knows its node.  Thieves then try the slots of their own node before
+ *  those of other nodes.  A task with a preferred node (PoolTask::Node_)
+ *  submitted from elsewhere goes to that node's queue, which the node's
+ *  threads check right after their own deque; other threads only take from
+ *  it once they have nothing else to do.
+ * 
+ *  What idle workers do is up to their IdlePolicies, by default they spin
+ *  briefly and then sleep until a task is submitted.
+ */
+class WorkStealingPool{
+public:
+    /** \brief Starts a pool of \p NThreads threads (the calling thread is
+     *         one of them)
+     * 
+     *  \param[in] Topology If given, the workers are pinned to its CPUs and
+     *                      scheduling prefers the same node.  It must
+     *                      outlive the pool.
+     *  \param[in] SpreadOffset Worker i is pinned to
+     *                      Topology->spread_cpu(SpreadOffset+i), so pools of
+     *                      processes sharing CPUs can use different ones.
+     */
+    WorkStealingPool(size_t NThreads,const NumaTopology* Topology=nullptr,
+                     size_t SpreadOffset=0);
+    
+    ///Waits for the workers to finish their current tasks and stops them
+    ~WorkStealingPool();
+    
+    ///Pools own threads so they can be neither copied nor moved
+    ///@{
+    WorkStealingPool(const WorkStealingPool&)=delete;
+    WorkStealingPool& operator=(const WorkStealingPool&)=delete;
+    ///@}
+    
+    size_t size()const{return Slots_.size();}///<Number of threads in the pool
+    
+    ///Schedules \p Task, which the pool will call execute() on exactly once
+    void submit(PoolTask* Task);
+    
+    ///Runs one task if one can be found, returns false otherwise
+    bool run_one();
+    
+    ///Tasks submitted but not yet taken by a thread (a snapshot)
+    size_t nqueued()const;
+    
+    ///Pops stale tasks off the bottom of the calling thread's deques
+    void drop_stale();
+    
+    ///Sets what idle workers do, \p SpinTime is only used by IDLE_SPIN
+    void set_idle_policy(IdlePolicies Policy,std::chrono::microseconds SpinTime);
+    
+    /** \brief Wakes every worker and has it touch its stack, returns once all
+     *         of them have or after WarmUpTime
+     * 
+     *  Workers that are running a task do so once it's done, so a worker
+     *  busy with a long task (or waiting on the caller) makes warm_up() wait
+     *  out the time limit instead.  Afterwards the workers idle as if they
+     *  had just run a task (e.g. spin for the IDLE_SPIN time).  The calling
+     *  thread touches its stack too; if it is one of our workers it is not
+     *  waited for.
+     * 
+     *  \return True if every worker checked in in time
+     */
+    bool warm_up();
+    
+    ///The longest warm_up() waits for the workers
+    static constexpr std::chrono::milliseconds WarmUpTime=
+        std::chrono::milliseconds(1000);
+    
+    ///Writes to the top StackTouchBytes of the calling thread's stack, so
+    ///those pages are mapped before any task needs them
+    static void touch_stack();
+    
+    ///How much stack touch_stack() touches
+    static const size_t StackTouchBytes=64*1024;
+    
+    ///Counts a task the calling thread ran while waiting on its future,
+    ///instead of the pool scheduling it (see print())
+    void count_waited_run();
+    
+    /** \brief Reports how much work each slot ran and stole
+     * 
+     *  Counts the tasks the pool scheduled and, separately, those a thread of
+     *  the pool ran because it waited on them (see count_waited_run()).
+     *  Tasks run inline by add_task(), or by threads outside the pool, are
+     *  not counted.
+     */
+    std::string print()const;
+    
+private:
+    ///Everything a thread participating in the pool needs
+    struct Slot{
+        ChaseLevDeque<PoolTask*> Deques_[NPriorities];///< This slot's tasks
+        std::thread Thread_;///< The worker (not set for the master slot)
+        unsigned Seed_;///< State of the random number generator for stealing
+        size_t Node_;///< The NUMA node the slot's thread is on
+        std::atomic<size_t> NRun_;///< Number of tasks this slot ran
+        std::atomic<size_t> NStolen_;///< Number of those that were stolen
+        std::atomic<size_t> NWaited_;///< Tasks it ran waiting on their future
+        std::atomic<size_t> WarmedUp_;///< The last warm_up() this slot did
+        Slot(unsigned Seed,size_t Node):
+            Seed_(Seed),Node_(Node),NRun_(0),NStolen_(0),NWaited_(0),
+            WarmedUp_(0)
+        {}
+    };
+    
+    ///Tasks that would like to run on a given node
+    struct NodeQueue{
+        std::mutex Mutex_;///< Guards Tasks_
+        std::deque<PoolTask*> Tasks_[NPriorities];///< The tasks, per priority
+        std::atomic<size_t> NTasks_;///< Total size of Tasks_
+        NodeQueue():NTasks_(0){}
+        ///Takes the oldest task of priority \p P, NULL if there is none
+        PoolTask* pop(size_t P);
+    };
+    
+    const NumaTopology* Topology_;///< Where our threads are, NULL if unpinned
+    size_t SpreadOffset_;///< Where in Topology_'s spread our slots start
+    
+    std::vector<std::unique_ptr<Slot>> Slots_;///< One per thread
+    std::mutex InjectMutex_;///< Guards Injected_
+    ///Tasks submitted from outside the pool
+    std::deque<PoolTask*> Injected_[NPriorities];
+    ///Tasks with a preferred node, one queue per node (none if unpinned or
+    ///there's only one node)
+    std::vector<std::unique_ptr<NodeQueue>> NodeQueues_;
+    ///Tasks submitted, but not yet taken, per priority (counted just before
+    ///they are queued, so never less than what is queued)
+    std::atomic<size_t> NQueued_[NPriorities];
+    std::atomic<size_t> NSleeping_;///< Workers waiting on Wake_
+    std::atomic<bool> Stop_;///< Tells the workers to exit
+    std::atomic<IdlePolicies> IdlePolicy_;///< What idle workers do
+    std::atomic<size_t> SpinMicroseconds_;///< How long IDLE_SPIN polls
+    std::atomic<size_t> WarmUps_;///< Calls to warm_up() so far
+    std::mutex SleepMutex_;///< Mutex for Wake_
+    std::condition_variable Wake_;///< Used to wake sleeping workers
+    
+    Slot* my_slot()const;///< The calling thread's slot, NULL if it has none
+    ///For each priority, highest first: local pop, our node's queue,
+    ///injection queue, steal, then the other nodes' queues; \p Stolen set if
+    ///one of the latter two
+    PoolTask* find_task(Slot* Me,bool& Stolen);
+    ///Tries to steal a task of priority \p P from each slot once, those on
+    ///our node first
+    PoolTask* steal(Slot* Me,size_t P);
+    void run(PoolTask* Task,Slot* Me,bool Stolen);///< Runs and accounts task
+    ///True if an idle worker should look for work again rather than sleep,
+    ///\p NIdle is how often it looked in vain since \p IdleSince
+    bool keep_looking(size_t NIdle,
+                      std::chrono::steady_clock::time_point IdleSince)const;
+    void worker(size_t i);///< The main loop of worker \p i
+};
+
+}//End namespace LibTaskForce
+#endif /* LIBTASKFORCE_GUARD_WORKSTEALINGPOOL_HPP */
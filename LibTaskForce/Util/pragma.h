@@ -31,6 +31,7 @@ extern "C" {
     #define PRAGMA_WARNING_IGNORE_NONVIRTUAL_DTOR              _Pragma("warning(disable:444")
     #define PRAGMA_WARNING_IGNORE_UNUSED_FUNCTION              //! \todo add me
     #define PRAGMA_WARNING_IGNORE_UNRECOGNIZED_PRAGMA          _Pragma("warning(disable:161")
+    #define PRAGMA_UNROLL_8                                    _Pragma("unroll(8)")
 
 #elif defined(__GNUC__) || defined(__GNUG__)
 
@@ -54,6 +55,14 @@ extern "C" {
     #define PRAGMA_WARNING_IGNORE_NONVIRTUAL_DTOR              // Doesn't seem to warn in GCC
     #define PRAGMA_WARNING_IGNORE_UNUSED_FUNCTION              _Pragma("GCC diagnostic ignored \"-Wunused-function\"")
     #define PRAGMA_WARNING_IGNORE_UNRECOGNIZED_PRAGMA          _Pragma("GCC diagnostic ignored \"-Wunknown-pragmas\"")
+    #if defined(__clang__) || __GNUC__>=8
+    #define PRAGMA_UNROLL_8                                    _Pragma("GCC unroll 8")
+    #endif
+#endif
+
+//Fully unrolling a short inner loop is only an optimization
+#ifndef PRAGMA_UNROLL_8
+    #define PRAGMA_UNROLL_8
 #endif
 
 